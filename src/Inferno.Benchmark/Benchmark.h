@@ -0,0 +1,27 @@
+#pragma once
+
+#include <functional>
+#include "Types.h"
+
+namespace Inferno {
+    struct Level;
+}
+
+namespace Inferno::Benchmark {
+    struct Options {
+        filesystem::path DataPath = "."; // Folder containing descent.hog and descent2.hog
+        int Iterations = 10;
+    };
+
+    // Returns the paths of descent.hog and descent2.hog in the data folder. Missing hogs are skipped.
+    List<filesystem::path> FindHogs(const Options& options);
+
+    // Deserializes every level in the hogs and calls fn with the entry name
+    void ForEachLevel(const Options& options, const std::function<void(const string&, Level&)>& fn);
+
+    // Each benchmark returns a process exit code
+    int LevelReads(const Options& options);
+    int BvhKernels(const Options& options);
+    int SegmentWalks(const Options& options);
+    int StreamReads(const Options& options);
+}
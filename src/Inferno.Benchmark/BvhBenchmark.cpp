@@ -0,0 +1,145 @@
+#include "pch.h"
+#include <random>
+#include "Benchmark.h"
+#include "Level.h"
+#include "TriangleBvh.h"
+#include "ScopedTimer.h"
+
+namespace Inferno::Benchmark {
+    namespace {
+        constexpr int RAYS_PER_LEVEL = 10'000;
+        constexpr float MAX_RAY_DISTANCE = 400;
+        constexpr BvhKernel Kernels[] = { BvhKernel::Scalar, BvhKernel::SSE, BvhKernel::AVX };
+        constexpr string_view KernelNames[] = { "Scalar", "SSE", "AVX" };
+
+        struct TestRay {
+            Ray Value;
+            float MaxDist;
+        };
+
+        // Creates a BVH of the closed sides. Sides with walls are one sided so both triangle tests get used.
+        TriangleBvh CreateBvh(Level& level) {
+            List<TriangleBvh::Triangle> triangles;
+            auto& cache = level.Collision;
+            cache.Update(level);
+
+            for (int segId = 0; segId < level.Segments.size(); segId++) {
+                for (auto& sideId : SideIDs) {
+                    auto index = CollisionCache::SideIndex(SegID(segId), sideId);
+                    if (cache.IsConnected(index) && !cache.HasWall(index)) continue;
+
+                    for (int tri = index * 2; tri < index * 2 + 2; tri++) {
+                        triangles.push_back({
+                            .V0 = cache.V0(tri),
+                            .V1 = cache.V1(tri),
+                            .V2 = cache.V2(tri),
+                            .Normal = cache.Normal(tri),
+                            .OneSided = cache.HasWall(index)
+                        });
+                    }
+                }
+            }
+
+            return TriangleBvh(std::move(triangles));
+        }
+
+        // Casts half of the rays between segment centers, like the light visibility tests, and the rest in random directions.
+        // The seed is fixed so every run and every kernel sees the same rays.
+        List<TestRay> CreateRays(const Level& level) {
+            std::mt19937 rng(1234);
+            std::uniform_int_distribution<size_t> segment(0, level.Segments.size() - 1);
+            std::uniform_real_distribution<float> unit(-1, 1);
+            List<TestRay> rays;
+
+            for (int i = 0; i < RAYS_PER_LEVEL; i++) {
+                auto& start = level.Segments[segment(rng)].Center;
+                Vector3 dir;
+                float maxDist;
+
+                if (i % 2 == 0) {
+                    dir = level.Segments[segment(rng)].Center - start;
+                    maxDist = dir.Length();
+                }
+                else {
+                    dir = Vector3(unit(rng), unit(rng), unit(rng));
+                    maxDist = (unit(rng) + 1) * 0.5f * MAX_RAY_DISTANCE;
+                }
+
+                if (dir.LengthSquared() < 0.001f) continue;
+                dir.Normalize();
+                rays.push_back({ Ray(start, dir), maxDist });
+            }
+
+            return rays;
+        }
+    }
+
+    // Casts the same rays with each kernel and fails if any kernel disagrees with the scalar one
+    int BvhKernels(const Options& options) {
+        int64 times[std::size(Kernels)]{};
+        bool supported[std::size(Kernels)]{};
+        size_t rayCount = 0;
+        int mismatches = 0;
+
+        ForEachLevel(options, [&](const string& name, Level& level) {
+            if (level.Segments.empty()) return;
+
+            auto bvh = CreateBvh(level);
+            auto rays = CreateRays(level);
+            List<ubyte> expected;
+
+            for (size_t k = 0; k < std::size(Kernels); k++) {
+                bvh.SetKernel(Kernels[k]);
+                if (bvh.GetKernel() != Kernels[k]) continue; // Not supported by this CPU
+                supported[k] = true;
+
+                List<ubyte> hits(rays.size());
+                int tests = 0;
+
+                {
+                    ScopedTimer timer(&times[k]);
+                    for (int iteration = 0; iteration < options.Iterations; iteration++) {
+                        for (size_t i = 0; i < rays.size(); i++)
+                            hits[i] = bvh.AnyHit(rays[i].Value, rays[i].MaxDist, tests);
+                    }
+                }
+
+                if (Kernels[k] == BvhKernel::Scalar) {
+                    expected = std::move(hits);
+                    continue;
+                }
+
+                for (size_t i = 0; i < rays.size(); i++) {
+                    if (hits[i] == expected[i]) continue;
+
+                    if (mismatches++ < 10) {
+                        fmt::print("{}: {} kernel returned {} for ray {}, scalar returned {}\n",
+                                   name, KernelNames[k], (bool)hits[i], i, (bool)expected[i]);
+                    }
+                }
+            }
+
+            rayCount += rays.size();
+        });
+
+        if (rayCount == 0) {
+            fmt::print("No levels found\n");
+            return 1;
+        }
+
+        for (size_t k = 0; k < std::size(Kernels); k++) {
+            if (supported[k])
+                fmt::print("{:<6} {} us for {} rays\n", KernelNames[k], times[k], rayCount * options.Iterations);
+            else
+                fmt::print("{:<6} not supported by this CPU\n", KernelNames[k]);
+        }
+
+        if (mismatches > 0) {
+            fmt::print("{} rays returned a different result than the scalar kernel\n", mismatches);
+            return 1;
+        }
+
+        fmt::print("All kernels returned the same results\n");
+        return 0;
+    }
+}
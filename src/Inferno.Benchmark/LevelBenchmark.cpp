@@ -0,0 +1,44 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include "HogFile.h"
+#include "Level.h"
+
+namespace Inferno::Benchmark {
+    // Deserializes every level in the hogs and prints the accumulated section times for each hog
+    int LevelReads(const Options& options) {
+        LevelReadTimes allTimes;
+        int allReads = 0;
+
+        for (auto& path : FindHogs(options)) {
+            auto hog = HogFile::Read(path);
+            LevelReadTimes times;
+            int reads = 0;
+
+            for (auto& entry : hog.GetLevels()) {
+                auto data = hog.ReadEntry(entry);
+
+                for (int i = 0; i < options.Iterations; i++) {
+                    LevelReadTimes levelTimes;
+                    auto level = Level::Deserialize(data, &levelTimes);
+                    times += levelTimes;
+                    reads++;
+                }
+            }
+
+            if (reads == 0) continue;
+            fmt::print("{}: {} reads. {} us per read\n", path.filename().string(), reads, times.Total / reads);
+            fmt::print("  Total {}\n", times.Format());
+            allTimes += times;
+            allReads += reads;
+        }
+
+        if (allReads == 0) {
+            fmt::print("No levels found\n");
+            return 1;
+        }
+
+        fmt::print("All: {} reads. {} us per read\n", allReads, allTimes.Total / allReads);
+        fmt::print("  Total {}\n", allTimes.Format());
+        return 0;
+    }
+}
@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include "HogFile.h"
+#include "Streams.h"
+#include "ScopedTimer.h"
+
+namespace Inferno::Benchmark {
+    namespace {
+        constexpr size_t RECORD_SIZE = 32;
+
+        // Reads the buffer as records of mixed fields, similar to the level and HAM parsers.
+        // Returns a sum of the values so every backend can be checked against the others.
+        double ReadRecords(StreamReader& reader, size_t size) {
+            double sum = 0;
+
+            for (size_t i = 0; i + RECORD_SIZE <= size; i += RECORD_SIZE) {
+                sum += reader.ReadInt32();
+                sum += reader.ReadInt16();
+                sum += reader.ReadUInt16();
+                for (int b = 0; b < 4; b++)
+                    sum += reader.ReadByte();
+
+                auto v = reader.ReadVector();
+                sum += v.x + v.y + v.z;
+                sum += reader.ReadFix();
+                sum += reader.ReadUInt32();
+            }
+
+            return sum;
+        }
+
+        // Copies every level in the hogs into one buffer
+        List<ubyte> ReadLevelData(const Options& options) {
+            List<ubyte> data;
+
+            for (auto& path : FindHogs(options)) {
+                auto hog = HogFile::Read(path);
+
+                for (auto& entry : hog.GetLevels()) {
+                    auto level = hog.ReadEntry(entry);
+                    data.insert(data.end(), level.begin(), level.end());
+                }
+            }
+
+            return data;
+        }
+    }
+
+    // Reads the level data with the memory backend, through a MemoryStream like memory readers used to, and from a file
+    int StreamReads(const Options& options) {
+        auto data = ReadLevelData(options);
+        if (data.empty()) {
+            fmt::print("No levels found\n");
+            return 1;
+        }
+
+        auto file = filesystem::temp_directory_path() / "Inferno.Benchmark.bin";
+        {
+            std::ofstream stream(file, std::ios::binary);
+            stream.write((char*)data.data(), data.size());
+        }
+
+        struct Backend {
+            string_view Name;
+            std::function<StreamReader()> Open;
+            int64 Time = 0;
+            double Sum = 0;
+        };
+
+        Backend backends[] = {
+            { "Memory", [&] { return StreamReader(span<const ubyte>(data)); } },
+            { "MemoryStream", [&] { return StreamReader(std::make_unique<MemoryStream>((char*)data.data(), data.size())); } },
+            { "File", [&] { return StreamReader(std::make_unique<std::ifstream>(file, std::ios::binary)); } }
+        };
+
+        for (int iteration = 0; iteration < options.Iterations; iteration++) {
+            for (auto& backend : backends) {
+                ScopedTimer timer(&backend.Time);
+                auto reader = backend.Open();
+                backend.Sum = ReadRecords(reader, data.size());
+            }
+        }
+
+        filesystem::remove(file);
+
+        fmt::print("Read {} KB {} times\n", data.size() / 1024, options.Iterations);
+        int result = 0;
+
+        for (auto& backend : backends) {
+            fmt::print("{:<13} {} us\n", backend.Name, backend.Time);
+
+            if (backend.Sum != backends[0].Sum) {
+                fmt::print("{} read different values than the memory backend\n", backend.Name);
+                result = 1;
+            }
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,132 @@
+#include "pch.h"
+#include <random>
+#include "Benchmark.h"
+#include "Level.h"
+#include "SegmentWalk.h"
+#include "ScopedTimer.h"
+
+using namespace DirectX;
+
+namespace Inferno::Benchmark {
+    namespace {
+        constexpr int PROJECTILES_PER_LEVEL = 5000;
+        constexpr float MIN_RADIUS = 0.5f; // Lasers and other small shots
+        constexpr float MAX_RADIUS = 20; // Explosion splash
+
+        struct Projectile {
+            SegID Segment;
+            BoundingSphere Sphere;
+        };
+
+        // Same side test as the physics sphere-level intersection, without the contact point
+        bool TouchesSide(const CollisionCache& cache, int side, const BoundingSphere& sphere) {
+            for (int tri = side * 2; tri < side * 2 + 2; tri++) {
+                if (std::abs(cache.PlaneDistance(tri, sphere.Center)) > sphere.Radius) continue;
+                if (sphere.Intersects(cache.V0(tri), cache.V1(tri), cache.V2(tri))) return true;
+            }
+
+            return false;
+        }
+
+        // Previous walk. Recurses into connected sides and records visited segments in a set.
+        void WalkWithSet(const Level& level, const BoundingSphere& sphere, SegID segId, Set<SegID>& visited) {
+            visited.insert(segId);
+            auto& seg = level.GetSegment(segId);
+
+            for (auto& side : SideIDs) {
+                auto index = CollisionCache::SideIndex(segId, side);
+                if (!level.Collision.IsConnected(index) || !TouchesSide(level.Collision, index, sphere)) continue;
+
+                auto conn = seg.GetConnection(side);
+                if (conn > SegID::None && !visited.contains(conn))
+                    WalkWithSet(level, sphere, conn, visited);
+            }
+        }
+
+        // Current walk. Marks visited segments with the walk's epoch and keeps pending segments on a stack.
+        size_t WalkWithMarks(const Level& level, const BoundingSphere& sphere, SegID start, SegmentWalk& walk) {
+            size_t visited = 0;
+            walk.Begin(level, start);
+
+            SegID segId{};
+            while (walk.Pop(segId)) {
+                visited++;
+                auto& seg = level.GetSegment(segId);
+
+                for (auto& side : SideIDs) {
+                    auto index = CollisionCache::SideIndex(segId, side);
+                    if (!level.Collision.IsConnected(index) || !TouchesSide(level.Collision, index, sphere)) continue;
+
+                    auto conn = seg.GetConnection(side);
+                    if (conn > SegID::None)
+                        walk.Push(conn);
+                }
+            }
+
+            return visited;
+        }
+
+        // Places projectiles at random segment centers. The seed is fixed so every run uses the same projectiles.
+        List<Projectile> CreateProjectiles(const Level& level) {
+            std::mt19937 rng(1234);
+            std::uniform_int_distribution<int> segment(0, (int)level.Segments.size() - 1);
+            std::uniform_real_distribution<float> radius(MIN_RADIUS, MAX_RADIUS);
+            List<Projectile> projectiles;
+
+            for (int i = 0; i < PROJECTILES_PER_LEVEL; i++) {
+                auto segId = SegID(segment(rng));
+                projectiles.push_back({ segId, BoundingSphere(level.GetSegment(segId).Center, radius(rng)) });
+            }
+
+            return projectiles;
+        }
+    }
+
+    // Walks the segments touched by many projectiles with the set based and the epoch mark walks
+    int SegmentWalks(const Options& options) {
+        int64 setTime = 0, markTime = 0;
+        size_t setVisits = 0, markVisits = 0, walks = 0;
+        SegmentWalk walk;
+
+        ForEachLevel(options, [&](const string&, Level& level) {
+            if (level.Segments.empty()) return;
+            level.Collision.Update(level);
+            auto projectiles = CreateProjectiles(level);
+
+            for (int iteration = 0; iteration < options.Iterations; iteration++) {
+                {
+                    ScopedTimer timer(&setTime);
+                    for (auto& projectile : projectiles) {
+                        Set<SegID> visited; // A new set for every object, like the hit info that used to hold it
+                        WalkWithSet(level, projectile.Sphere, projectile.Segment, visited);
+                        setVisits += visited.size();
+                    }
+                }
+
+                {
+                    ScopedTimer timer(&markTime);
+                    for (auto& projectile : projectiles)
+                        markVisits += WalkWithMarks(level, projectile.Sphere, projectile.Segment, walk);
+                }
+            }
+
+            walks += projectiles.size() * options.Iterations;
+        });
+
+        if (walks == 0) {
+            fmt::print("No levels found\n");
+            return 1;
+        }
+
+        fmt::print("{} walks, {} segments visited\n", walks, markVisits);
+        fmt::print("Set<SegID>  {} us\n", setTime);
+        fmt::print("Epoch marks {} us\n", markTime);
+
+        if (setVisits != markVisits) {
+            fmt::print("The set walk visited {} segments\n", setVisits);
+            return 1;
+        }
+
+        return 0;
+    }
+}
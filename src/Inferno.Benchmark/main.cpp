@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include "HogFile.h"
+#include "Level.h"
+
+using namespace Inferno;
+using namespace Inferno::Benchmark;
+
+namespace {
+    struct Command {
+        string_view Name;
+        string_view Description;
+        int (*Run)(const Options&);
+    };
+
+    constexpr Command Commands[] = {
+        { "levels", "Reads every level in the hogs and prints the section times", LevelReads },
+        { "bvh", "Checks that every BVH kernel returns the same ray hits", BvhKernels },
+        { "walk", "Compares the set based and epoch mark segment walks with many projectiles", SegmentWalks },
+        { "streams", "Reads the level data with each StreamReader backend", StreamReads },
+    };
+
+    void PrintUsage() {
+        fmt::print("Usage: Inferno.Benchmark <command|all> [data folder] [iterations]\n");
+        for (auto& command : Commands)
+            fmt::print("  {:<10} {}\n", command.Name, command.Description);
+    }
+}
+
+namespace Inferno::Benchmark {
+    List<filesystem::path> FindHogs(const Options& options) {
+        List<filesystem::path> hogs;
+
+        for (auto name : { "descent.hog", "descent2.hog" }) {
+            auto path = options.DataPath / name;
+            if (filesystem::exists(path))
+                hogs.push_back(path);
+            else
+                fmt::print("{} not found, skipping\n", path.string());
+        }
+
+        return hogs;
+    }
+
+    void ForEachLevel(const Options& options, const std::function<void(const string&, Level&)>& fn) {
+        for (auto& path : FindHogs(options)) {
+            auto hog = HogFile::Read(path);
+
+            for (auto& entry : hog.GetLevels()) {
+                auto data = hog.ReadEntry(entry);
+                auto level = Level::Deserialize(data);
+                fn(entry.Name, level);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    string_view name = argv[1];
+    Options options;
+    if (argc > 2) options.DataPath = argv[2];
+    if (argc > 3) options.Iterations = std::max(std::atoi(argv[3]), 1);
+
+    try {
+        int result = 0;
+        bool found = false;
+
+        for (auto& command : Commands) {
+            if (name != "all" && name != command.Name) continue;
+            found = true;
+            fmt::print("== {} ==\n", command.Name);
+            result |= command.Run(options);
+        }
+
+        if (!found) {
+            PrintUsage();
+            return 1;
+        }
+
+        return result;
+    }
+    catch (const std::exception& e) {
+        fmt::print("Error: {}\n", e.what());
+        return 1;
+    }
+}
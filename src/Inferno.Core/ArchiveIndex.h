@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Types.h"
+
+namespace Inferno {
+    // Case-insensitive name lookup for archive entries (HOG, HOG2).
+    // Names are case-folded and hashed once when added so queries don't allocate or scan the entry list.
+    class ArchiveIndex {
+        struct Slot {
+            uint32 Hash = 0;
+            int Index = -1; // Entry index, -1 when empty
+            string Name; // Case-folded name
+        };
+
+        List<Slot> _slots; // Open addressing table, size is always a power of two
+        size_t _count = 0;
+        Dictionary<string, List<int>> _extensions; // Entry indices keyed by case-folded extension
+
+        static constexpr char Fold(char c) {
+            return c >= 'A' && c <= 'Z' ? char(c + ('a' - 'A')) : c;
+        }
+
+        static string FoldCopy(string_view s) {
+            string folded(s.size(), '\0');
+            std::transform(s.begin(), s.end(), folded.begin(), Fold);
+            return folded;
+        }
+
+        static constexpr bool FoldedEquals(string_view folded, string_view s) {
+            if (folded.size() != s.size()) return false;
+
+            for (size_t i = 0; i < s.size(); i++)
+                if (folded[i] != Fold(s[i])) return false;
+
+            return true;
+        }
+
+        void Grow() {
+            auto slots = std::move(_slots);
+            _slots = List<Slot>(slots.empty() ? 64 : slots.size() * 2);
+
+            for (auto& slot : slots) {
+                if (slot.Index < 0) continue;
+                auto i = Probe(slot.Hash, slot.Name);
+                _slots[i] = std::move(slot);
+            }
+        }
+
+        // Returns the slot containing the name, or the empty slot where it would be inserted
+        size_t Probe(uint32 hash, string_view name) const {
+            auto mask = _slots.size() - 1;
+            auto i = hash & mask;
+
+            while (_slots[i].Index >= 0) {
+                if (_slots[i].Hash == hash && FoldedEquals(_slots[i].Name, name))
+                    break;
+
+                i = (i + 1) & mask;
+            }
+
+            return i;
+        }
+
+    public:
+        // Case-insensitive FNV-1a hash (ASCII only)
+        static constexpr uint32 Hash(string_view s) {
+            uint32 hash = 2166136261u;
+            for (auto c : s) {
+                hash ^= (ubyte)Fold(c);
+                hash *= 16777619u;
+            }
+
+            return hash;
+        }
+
+        // Returns the extension of a name without the dot. Matches HogEntry::Extension().
+        static constexpr string_view GetExtension(string_view name) {
+            auto i = name.find('.');
+            if (i == string_view::npos) return {};
+            return name.substr(i + 1);
+        }
+
+        void Clear() {
+            _slots.clear();
+            _extensions.clear();
+            _count = 0;
+        }
+
+        // Adds an entry to the index. If the name already exists the first entry is kept.
+        void Add(string_view name, int index) {
+            if ((_count + 1) * 2 > _slots.size())
+                Grow();
+
+            auto hash = Hash(name);
+            auto i = Probe(hash, name);
+            if (_slots[i].Index >= 0) return; // Duplicate name
+
+            auto& slot = _slots[i];
+            slot.Hash = hash;
+            slot.Index = index;
+            slot.Name = FoldCopy(name);
+            _count++;
+
+            _extensions[FoldCopy(GetExtension(name))].push_back(index);
+        }
+
+        // Returns the index of an entry by name. Case insensitive.
+        Option<int> Find(string_view name) const {
+            if (_slots.empty()) return {};
+            auto& slot = _slots[Probe(Hash(name), name)];
+            if (slot.Index < 0) return {};
+            return slot.Index;
+        }
+
+        bool Contains(string_view name) const { return Find(name).has_value(); }
+
+        // Returns the indices of all entries with an extension. The leading dot is optional.
+        span<const int> FindByExtension(string_view extension) const {
+            if (extension.starts_with('.')) extension.remove_prefix(1);
+            auto bucket = _extensions.find(FoldCopy(extension));
+            if (bucket == _extensions.end()) return {};
+            return bucket->second;
+        }
+
+        bool ContainsExtension(string_view extension) const {
+            return !FindByExtension(extension).empty();
+        }
+
+        size_t Size() const { return _count; }
+    };
+}
@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "BitmapStore.h"
+
+namespace Inferno {
+    namespace {
+        size_t GetBitmapSize(const PigBitmap& bmp) {
+            return (bmp.Data.size() + bmp.Mask.size()) * sizeof(Palette::Color) + bmp.Indexed.size();
+        }
+
+        Ref<PigBitmap> CopyIndices(const PigBitmap& bmp) {
+            auto copy = MakeRef<PigBitmap>(bmp.Info);
+            copy->Indexed = bmp.Indexed;
+            return copy;
+        }
+    }
+
+    BitmapStore::BitmapStore(const PigFile& pig, const Palette& palette, size_t budget, bool indexedOnly)
+        : _dataStart(pig.DataStart), _entries(pig.Entries), _palette(palette), _budget(budget), _indexedOnly(indexedOnly) {
+        _file = MakePtr<MappedFile>(pig.Path);
+        _slots.resize(_entries.size());
+    }
+
+    PigBitmap BitmapStore::Decode(int index) const {
+        StreamReader reader(_file->Data());
+        return ReadBitmapEntry(reader, _dataStart, _entries[index], _palette);
+    }
+
+    const Ref<PigBitmap>& BitmapStore::Resolve(int index) {
+        auto& slot = _slots[index];
+        Touch(index);
+        if (slot.Resolved) return slot.Resolved;
+
+        if (!_indexedOnly) {
+            slot.Resolved = MakeRef<PigBitmap>(Decode(index));
+        }
+        else if (slot.Indexed) {
+            // Expand the resident indices instead of decoding again
+            auto bmp = CopyIndices(*slot.Indexed);
+            ResolveBitmapColors(*bmp, _palette);
+            slot.Resolved = bmp;
+        }
+        else {
+            slot.Resolved = MakeRef<PigBitmap>(Decode(index));
+            slot.Indexed = CopyIndices(*slot.Resolved);
+        }
+
+        if (!slot.Average)
+            slot.Average = Inferno::GetAverageColor(slot.Resolved->Data);
+
+        UpdateSize(slot);
+        Trim(index);
+        return slot.Resolved;
+    }
+
+    void BitmapStore::Touch(int index) {
+        auto& slot = _slots[index];
+
+        if (slot.Used) {
+            _lru.splice(_lru.begin(), _lru, slot.Position);
+        }
+        else {
+            _lru.push_front(index);
+            slot.Position = _lru.begin();
+            slot.Used = true;
+        }
+    }
+
+    void BitmapStore::UpdateSize(Slot& slot) {
+        _size -= slot.Size;
+        slot.Size = 0;
+        if (slot.Indexed) slot.Size += GetBitmapSize(*slot.Indexed);
+        if (slot.Resolved) slot.Size += GetBitmapSize(*slot.Resolved);
+        _size += slot.Size;
+    }
+
+    void BitmapStore::Trim(int keep) {
+        if (_size <= _budget) return;
+
+        // Release expanded colors first so the compact indices stay resident
+        if (_indexedOnly) {
+            for (auto it = _lru.rbegin(); it != _lru.rend() && _size > _budget; ++it) {
+                auto& slot = _slots[*it];
+                if (*it == keep || !slot.Resolved) continue;
+                slot.Resolved.reset();
+                UpdateSize(slot);
+            }
+        }
+
+        auto it = _lru.end();
+        while (_size > _budget && it != _lru.begin()) {
+            --it;
+            if (*it == keep) continue;
+
+            auto& slot = _slots[*it];
+            slot.Indexed.reset();
+            slot.Resolved.reset();
+            slot.Used = false;
+            UpdateSize(slot);
+            it = _lru.erase(it);
+        }
+    }
+
+    Ref<const PigBitmap> BitmapStore::Get(TexID id) {
+        std::scoped_lock lock(_lock);
+        if (_entries.empty()) return MakeRef<PigBitmap>();
+        return Resolve(GetIndex(id));
+    }
+
+    Ref<const PigBitmap> BitmapStore::GetIndexed(TexID id) {
+        std::scoped_lock lock(_lock);
+        if (_entries.empty()) return MakeRef<PigBitmap>();
+
+        auto index = GetIndex(id);
+        if (!_indexedOnly) return Resolve(index);
+
+        auto& slot = _slots[index];
+        Touch(index);
+
+        if (!slot.Indexed) {
+            auto bmp = Decode(index);
+            if (!slot.Average) slot.Average = Inferno::GetAverageColor(bmp.Data);
+            bmp.Data = {};
+            bmp.Mask = {};
+            slot.Indexed = MakeRef<PigBitmap>(std::move(bmp));
+            UpdateSize(slot);
+            Trim(index);
+        }
+
+        return slot.Indexed;
+    }
+
+    Option<Color> BitmapStore::GetAverageColor(TexID id) const {
+        std::scoped_lock lock(_lock);
+        if (_entries.empty()) return {};
+        return _slots[GetIndex(id)].Average;
+    }
+
+    void BitmapStore::Clear() {
+        std::scoped_lock lock(_lock);
+
+        for (auto& slot : _slots) {
+            slot.Indexed.reset();
+            slot.Resolved.reset();
+            slot.Size = 0;
+            slot.Used = false;
+        }
+
+        _lru.clear();
+        _size = 0;
+    }
+
+    void BitmapStore::SetBudget(size_t budget) {
+        std::scoped_lock lock(_lock);
+        _budget = budget;
+        Trim(-1);
+    }
+}
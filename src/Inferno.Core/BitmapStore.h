@@ -0,0 +1,75 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include "Types.h"
+#include "Utility.h"
+#include "Pig.h"
+#include "MappedFile.h"
+
+namespace Inferno {
+    // Demand-paged PIG bitmaps. Textures are decoded on first access instead of all at once,
+    // and the least recently used ones are released when the store is over its memory budget.
+    //
+    // Bitmaps are returned as shared references so a released bitmap stays valid for anyone still using it.
+    class BitmapStore {
+        struct Slot {
+            Ref<PigBitmap> Indexed; // Indices only. Used in indexed mode.
+            Ref<PigBitmap> Resolved; // Indices and colors
+            size_t Size = 0; // Bytes held by the store
+            bool Used = false; // In the LRU list
+            Option<Color> Average; // Recorded on the first decode and kept after the bitmap is released
+            std::list<int>::iterator Position;
+        };
+
+        Ptr<MappedFile> _file;
+        size_t _dataStart = 0;
+        List<PigEntry> _entries;
+        Palette _palette;
+        List<Slot> _slots;
+        std::list<int> _lru; // Slot indices, most recently used first
+        size_t _budget = 0, _size = 0;
+        bool _indexedOnly = false;
+        mutable std::mutex _lock;
+
+        int GetIndex(TexID id) const { return Seq::inRange(_entries, (int)id) ? (int)id : 0; }
+        PigBitmap Decode(int index) const;
+        const Ref<PigBitmap>& Resolve(int index);
+        void Touch(int index);
+        void UpdateSize(Slot& slot);
+        void Trim(int keep); // Releases bitmaps until under budget, except for keep
+
+    public:
+        // Budget is in bytes. When indexedOnly is set the store only keeps 8-bit indices resident
+        // and expanded colors are released first when over budget.
+        BitmapStore(const PigFile& pig, const Palette& palette, size_t budget, bool indexedOnly = false);
+
+        BitmapStore(const BitmapStore&) = delete;
+        BitmapStore(BitmapStore&&) = delete;
+        BitmapStore& operator=(const BitmapStore&) = delete;
+        BitmapStore& operator=(BitmapStore&&) = delete;
+
+        // Returns a bitmap with resolved colors, decoding it if necessary. Invalid IDs return the first entry.
+        Ref<const PigBitmap> Get(TexID id);
+
+        // Returns a bitmap that is only guaranteed to contain indexed data
+        Ref<const PigBitmap> GetIndexed(TexID id);
+
+        // Returns the average color of a bitmap, or none if it hasn't been decoded yet
+        Option<Color> GetAverageColor(TexID id) const;
+
+        // Releases every decoded bitmap
+        void Clear();
+
+        void SetBudget(size_t budget);
+        size_t GetBudget() const { return _budget; }
+
+        // Bytes of decoded data held by the store
+        size_t GetSize() const {
+            std::scoped_lock lock(_lock);
+            return _size;
+        }
+
+        size_t Count() const { return _entries.size(); }
+    };
+}
@@ -0,0 +1,116 @@
+#include "pch.h"
+#include "CollisionCache.h"
+#include "Level.h"
+
+namespace Inferno {
+    namespace {
+        constexpr uint32 UNCACHED = ~0u;
+
+        // Möller-Trumbore intersection against a triangle with precomputed edges. Matches DirectX TriangleTests::Intersects.
+        bool IntersectTriangle(const Ray& ray, const Vector3& v0, const Vector3& e1, const Vector3& e2, float& dist) {
+            auto p = ray.direction.Cross(e2);
+            auto det = e1.Dot(p);
+            if (std::abs(det) <= 1e-20f) return false; // Parallel to the triangle
+
+            auto inv = 1 / det;
+            auto s = ray.position - v0;
+            auto u = s.Dot(p) * inv;
+            if (u < 0 || u > 1) return false;
+
+            auto q = s.Cross(e1);
+            auto v = ray.direction.Dot(q) * inv;
+            if (v < 0 || u + v > 1) return false;
+
+            auto t = e2.Dot(q) * inv;
+            if (t < 0) return false;
+
+            dist = t;
+            return true;
+        }
+    }
+
+    void CollisionCache::BuildSegment(const Level& level, int segIndex) {
+        auto& seg = level.Segments[segIndex];
+
+        for (auto& sideId : SideIDs) {
+            auto& side = seg.GetSide(sideId);
+            auto indices = seg.GetVertexIndices(sideId);
+            auto ri = side.GetRenderIndices();
+
+            for (int t = 0; t < 2; t++) {
+                auto tri = SideIndex(SegID(segIndex), sideId) * 2 + t;
+                _v0[tri] = level.Vertices[indices[ri[t * 3]]];
+                _v1[tri] = level.Vertices[indices[ri[t * 3 + 1]]];
+                _v2[tri] = level.Vertices[indices[ri[t * 3 + 2]]];
+                _e1[tri] = _v1[tri] - _v0[tri];
+                _e2[tri] = _v2[tri] - _v0[tri];
+                _normals[tri] = side.Normals[t];
+                _planeDist[tri] = side.Normals[t].Dot(_v0[tri]);
+            }
+        }
+
+        _versions[segIndex] = seg.GeometryVersion;
+    }
+
+    size_t CollisionCache::Update(const Level& level) {
+        auto segmentCount = level.Segments.size();
+
+        if (_versions.size() != segmentCount) {
+            // Segments that were added or shifted by a delete have mismatched versions and get recached below
+            auto triangles = segmentCount * 12;
+            _v0.resize(triangles);
+            _v1.resize(triangles);
+            _v2.resize(triangles);
+            _e1.resize(triangles);
+            _e2.resize(triangles);
+            _normals.resize(triangles);
+            _planeDist.resize(triangles);
+            _sideFlags.resize(segmentCount * 6);
+            _versions.resize(segmentCount, UNCACHED);
+        }
+
+        size_t rebuilt = 0;
+
+        for (int segIndex = 0; segIndex < segmentCount; segIndex++) {
+            auto& seg = level.Segments[segIndex];
+
+            if (_versions[segIndex] != seg.GeometryVersion || seg.GeometryVersion == 0) {
+                BuildSegment(level, segIndex);
+                rebuilt++;
+            }
+
+            // Connections and walls are edited without updating the geometry, so always refresh them
+            for (auto& sideId : SideIDs) {
+                ubyte flags = 0;
+                if (seg.SideHasConnection(sideId)) flags |= CONNECTED;
+                if (seg.SideIsWall(sideId)) flags |= HAS_WALL;
+                _sideFlags[SideIndex(SegID(segIndex), sideId)] = flags;
+            }
+        }
+
+        return rebuilt;
+    }
+
+    bool CollisionCache::IsSolid(int side, Level& level) const {
+        auto flags = _sideFlags[side];
+        if (!(flags & CONNECTED)) return true; // no connection
+        if (!(flags & HAS_WALL)) return false; // open side with no wall
+
+        auto& seg = level.Segments[side / 6];
+        if (auto wall = level.TryGetWall(seg.Sides[side % 6].Wall))
+            return wall->IsSolid(); // walls might be solid
+
+        return false;
+    }
+
+    bool CollisionCache::IntersectRay(int side, const Ray& ray, float& dist, bool hitBackface) const {
+        for (int tri = side * 2; tri < side * 2 + 2; tri++) {
+            if (!hitBackface && _normals[tri].Dot(ray.direction) >= 0) continue;
+
+            if (IntersectTriangle(ray, _v0[tri], _e1[tri], _e2[tri], dist))
+                return true;
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Types.h"
+
+namespace Inferno {
+    struct Level;
+
+    // Triangles of every segment side, precomputed so geometric queries read contiguous arrays
+    // instead of gathering vertices through the side and segment indices.
+    // Side n of segment s has index s * 6 + n, and its triangles are 2 * index and 2 * index + 1.
+    // Triangles follow the side's render indices and use its normals, so results match Face.
+    class CollisionCache {
+        static constexpr ubyte CONNECTED = 1 << 0;
+        static constexpr ubyte HAS_WALL = 1 << 1;
+
+        List<Vector3> _v0, _v1, _v2;
+        List<Vector3> _e1, _e2; // V1 - V0 and V2 - V0
+        List<Vector3> _normals;
+        List<float> _planeDist; // Normal dot V0
+        List<ubyte> _sideFlags;
+        List<uint32> _versions; // Geometry version of each segment when its triangles were cached
+
+        void BuildSegment(const Level& level, int segIndex);
+
+    public:
+        CollisionCache() = default;
+
+        // Copies start empty and are rebuilt on their first update, so undo snapshots and other level copies
+        // don't carry the triangles. Assigning also empties the cache, since the segment versions no longer apply.
+        CollisionCache(const CollisionCache&) {}
+        CollisionCache& operator=(const CollisionCache&) {
+            Clear();
+            return *this;
+        }
+
+        CollisionCache(CollisionCache&&) = default;
+        CollisionCache& operator=(CollisionCache&&) = default;
+
+        // Recaches segments whose geometry changed since the last update. Side flags are refreshed for every side.
+        // Returns the number of segments that were recached.
+        size_t Update(const Level& level);
+
+        void Clear() {
+            _versions.clear();
+            _sideFlags.clear();
+        }
+
+        static constexpr int SideIndex(SegID seg, SideID side) { return (int)seg * 6 + (int)side; }
+
+        const Vector3& V0(int tri) const { return _v0[tri]; }
+        const Vector3& V1(int tri) const { return _v1[tri]; }
+        const Vector3& V2(int tri) const { return _v2[tri]; }
+        const Vector3& Normal(int tri) const { return _normals[tri]; }
+
+        // Signed distance of a point from the plane of a triangle
+        float PlaneDistance(int tri, const Vector3& point) const {
+            return _normals[tri].Dot(point) - _planeDist[tri];
+        }
+
+        bool IsConnected(int side) const { return _sideFlags[side] & CONNECTED; }
+        bool HasWall(int side) const { return _sideFlags[side] & HAS_WALL; }
+
+        // Same as Segment::SideIsSolid. Only sides with walls look at the level, since doors change at runtime.
+        bool IsSolid(int side, Level& level) const;
+
+        // Intersects a ray with the triangles of a side. Back faces are skipped unless hitBackface is set.
+        bool IntersectRay(int side, const Ray& ray, float& dist, bool hitBackface = false) const;
+
+        size_t SegmentCount() const { return _versions.size(); }
+    };
+}
@@ -2,6 +2,7 @@
 
 #include "Types.h"
 #include "Streams.h"
+#include "ArchiveIndex.h"
 
 // Descent 3 HOG2 file
 namespace Inferno {
@@ -9,7 +10,7 @@ namespace Inferno {
         static constexpr int PSFILENAME_LEN = 35;
         static constexpr int HOG_HDR_SIZE = 64;
 
-        Dictionary<string, int> _lookup;
+        ArchiveIndex _index;
     public:
         filesystem::path Path;
 
@@ -46,7 +47,7 @@ namespace Inferno {
                 entry.offset = offset;
                 offset += entry.len;
 
-                hog._lookup.insert({ entry.name, i });
+                hog._index.Add(entry.name, i);
             }
 
             return hog;
@@ -66,12 +67,13 @@ namespace Inferno {
             return data;
         }
 
-        Option<List<ubyte>> ReadEntry(string name) {
-            name = String::ToLower(name);
-            if (!_lookup.contains(name))
-                return {};
-            
-            return ReadEntry(_lookup[name]);
+        Option<List<ubyte>> ReadEntry(string_view name) {
+            if (auto index = _index.Find(name))
+                return ReadEntry(*index);
+
+            return {};
         }
+
+        bool Exists(string_view name) const { return _index.Contains(name); }
     };
 }
\ No newline at end of file
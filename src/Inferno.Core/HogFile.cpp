@@ -26,6 +26,16 @@ namespace Inferno {
         return buffer;
     }
 
+    void HogFile::Map() {
+        if (_mapping) return;
+        _mapping = MakePtr<MappedFile>(Path);
+    }
+
+    span<const ubyte> HogFile::ViewEntry(const HogEntry& entry) const {
+        if (!_mapping || entry.IsImport()) return {};
+        return _mapping->Slice(entry.Offset, entry.Size);
+    }
+
     List<ubyte> HogFile::ReadEntry(const HogEntry& entry) const {
         if (entry.Path != "") {
             auto size = filesystem::file_size(entry.Path);
@@ -36,6 +46,10 @@ namespace Inferno {
             src.read((char*)data.data(), size);
             return data;
         }
+        else if (_mapping) {
+            auto view = ViewEntry(entry);
+            return { view.begin(), view.end() };
+        }
         else {
             return ReadFileToMemory(Path, entry.Offset, entry.Size);
         }
@@ -43,34 +57,40 @@ namespace Inferno {
 
     List<ubyte> HogFile::TryReadEntry(int index) const {
         if (auto entry = Seq::tryItem(Entries, index))
-            return ReadFileToMemory(Path, entry->Offset, entry->Size);
+            return ReadEntry(*entry);
         else
             return {};
     }
 
     List<ubyte> HogFile::TryReadEntry(string_view entry) const {
-        for (auto& e : Entries)
-            if (String::InvariantEquals(e.Name, entry)) 
-                return ReadFileToMemory(Path, e.Offset, e.Size);
+        if (auto index = _index.Find(entry))
+            return ReadEntry(Entries[*index]);
 
         return {};
     }
 
     bool HogFile::Exists(string_view entry) const {
-        for (auto& e : Entries)
-            if (String::InvariantEquals(e.Name, entry)) return true;
-
-        return false;
+        return _index.Contains(entry);
     }
 
     const HogEntry& HogFile::FindEntry(string_view entry) const {
-        for (auto& e : Entries)
-            if (String::InvariantEquals(e.Name, entry)) return e;
+        if (auto index = _index.Find(entry))
+            return Entries[*index];
 
         throw Exception("File not found in hog file");
     }
 
-    HogFile HogFile::Read(filesystem::path file) {
+    void HogFile::UpdateIndex() {
+        _index.Clear();
+
+        for (int i = 0; i < Entries.size(); i++)
+            _index.Add(Entries[i].Name, i);
+
+        _isDescent1 = _index.ContainsExtension("rdl");
+        _isDescent2 = _index.ContainsExtension("rl2");
+    }
+
+    HogFile HogFile::Read(filesystem::path file, bool map) {
         HogFile hog{};
         hog.Path = file;
         StreamReader reader(file);
@@ -91,13 +111,142 @@ namespace Inferno {
             reader.SeekForward(entry.Size);
         }
 
+        hog.UpdateIndex();
+
+        if (map)
+            hog.Map();
+
         return hog;
     }
 
+    void HogUpdate::Remove(string_view name) {
+        // Hogs can contain the same name more than once, so drop every copy
+        for (size_t i = 0; i < _source.Entries.size(); i++) {
+            if (String::InvariantEquals(_source.Entries[i].Name, name))
+                _keep[i] = false;
+        }
+
+        std::erase_if(_entries, [name](const NewEntry& e) { return String::InvariantEquals(e.Name, name); });
+    }
+
+    void HogUpdate::WriteEntry(string_view name, List<ubyte> data) {
+        Remove(name);
+        _entries.push_back({ string(name), std::move(data) });
+    }
 
+    namespace {
+        // Copies a byte range between files using a large buffer
+        void CopyRange(std::ifstream& src, std::ofstream& dest, size_t offset, size_t length) {
+            constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+            List<char> buffer(std::min(length, BUFFER_SIZE));
+            src.seekg(offset);
+
+            while (length > 0) {
+                auto chunk = std::min(length, buffer.size());
+                if (!src.read(buffer.data(), chunk))
+                    throw Exception("Unable to read source HOG");
+
+                dest.write(buffer.data(), chunk);
+                length -= chunk;
+            }
+        }
+    }
 
+    void HogUpdate::Commit(const filesystem::path& path, string_view backupExtension) {
+        WriteTemporary(path);
 
+        if (path == _source.Path)
+            _source.Unmap(); // Release the file so it can be replaced
 
+        Replace(path, backupExtension);
+    }
 
+    void HogUpdate::Replace(const filesystem::path& path, string_view backupExtension) {
+        File::ReplaceWithBackup(TemporaryPath(path), path, backupExtension);
+    }
+
+    void HogUpdate::WriteTemporary(const filesystem::path& path) {
+        struct Range {
+            size_t Begin, End;
+        };
+
+        // Merge adjacent unchanged entries into ranges of the source file
+        List<Range> ranges;
+        List<NewEntry> imports;
+        size_t entryCount = _entries.size();
+
+        for (size_t i = 0; i < _source.Entries.size(); i++) {
+            if (!_keep[i]) continue;
+            auto& entry = _source.Entries[i];
+            if (entry.Size == 0) continue;
+            entryCount++;
+
+            if (entry.IsImport()) {
+                imports.push_back({ entry.Name, _source.ReadEntry(entry) });
+                continue;
+            }
+
+            auto begin = entry.Offset - HOG_ENTRY_HEADER_SIZE;
+            auto end = entry.Offset + entry.Size;
+
+            if (!ranges.empty() && ranges.back().End == begin)
+                ranges.back().End = end;
+            else
+                ranges.push_back({ begin, end });
+        }
 
-}
\ No newline at end of file
+        if (entryCount > HogFile::MAX_ENTRIES)
+            throw Exception("Cannot have more than 250 entries!");
+
+        auto temp = TemporaryPath(path);
+
+        try {
+            constexpr size_t HOG_HEADER_SIZE = 3;
+            auto rangeStart = ranges.begin();
+
+            // When most of the archive is unchanged, let the OS copy the leading range.
+            // It can clone or copy the file without passing it through this process.
+            if (!ranges.empty() && ranges[0].Begin == HOG_HEADER_SIZE &&
+                ranges[0].End * 2 >= filesystem::file_size(_source.Path)) {
+                filesystem::copy_file(_source.Path, temp, filesystem::copy_options::overwrite_existing);
+                filesystem::resize_file(temp, ranges[0].End);
+                ++rangeStart;
+            }
+            else {
+                std::ofstream header(temp, std::ios::binary | std::ios::trunc);
+                header.write("DHF", HOG_HEADER_SIZE);
+                if (!header) throw Exception("Unable to write HOG file");
+            }
+
+            std::ofstream stream(temp, std::ios::binary | std::ios::app);
+            StreamWriter writer(stream);
+
+            if (rangeStart != ranges.end()) {
+                std::ifstream source(_source.Path, std::ios::binary);
+                for (auto range = rangeStart; range != ranges.end(); ++range)
+                    CopyRange(source, stream, range->Begin, range->End - range->Begin);
+            }
+
+            auto writeEntry = [&writer](const NewEntry& entry) {
+                if (entry.Data.empty()) return;
+                writer.WriteString(entry.Name, 13);
+                writer.Write((int32)entry.Data.size());
+                writer.WriteBytes(entry.Data);
+            };
+
+            for (auto& entry : imports)
+                writeEntry(entry);
+
+            for (auto& entry : _entries)
+                writeEntry(entry);
+
+            stream.close();
+            if (!stream) throw Exception("Unable to write HOG file");
+        }
+        catch (...) {
+            std::error_code ec;
+            filesystem::remove(temp, ec);
+            throw;
+        }
+    }
+}
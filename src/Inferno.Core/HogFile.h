@@ -4,6 +4,8 @@
 #include "Utility.h"
 #include <fstream>
 #include "Streams.h"
+#include "MappedFile.h"
+#include "ArchiveIndex.h"
 
 namespace Inferno {
     struct HogEntry {
@@ -44,11 +46,15 @@ namespace Inferno {
     // Contains menu backgrounds, palettes, music, levels
     // A hog file is simply a list of files joined together with name and length headers.
     class HogFile {
+        Ptr<MappedFile> _mapping;
+        ArchiveIndex _index;
+        bool _isDescent1 = false, _isDescent2 = false;
     public:
         List<HogEntry> Entries;
         std::filesystem::path Path;
 
         // Reads data from an entry. Can come from the HogFile Path or a file system path.
+        // Returns a copy of the data, served from the mapping if the hog is mapped.
         List<ubyte> ReadEntry(const HogEntry& entry) const;
 
         List<ubyte> ReadEntry(string_view name) const {
@@ -59,19 +65,39 @@ namespace Inferno {
         List<ubyte> TryReadEntry(int index) const;
         List<ubyte> TryReadEntry(string_view entry) const;
 
+        // Maps the archive into memory so entries can be viewed without copying.
+        // The file stays open until Unmap() is called or the hog is destroyed.
+        void Map();
+
+        // Releases the mapping. Must be called before the archive is replaced on disk.
+        void Unmap() { _mapping.reset(); }
+
+        bool IsMapped() const { return (bool)_mapping; }
+
+        // Returns a view of an entry in the mapped archive. The view is invalidated by Unmap().
+        // Returns empty if the hog is not mapped or the entry is an import.
+        span<const ubyte> ViewEntry(const HogEntry& entry) const;
+
+        span<const ubyte> ViewEntry(string_view name) const {
+            return ViewEntry(FindEntry(name));
+        }
+
         bool Exists(string_view entry) const;
         const HogEntry& FindEntry(string_view entry) const;
 
-        bool ContainsFileType(string_view extension) const {
-            for (auto& entry : Entries) {
-                if (entry.Name.ends_with(extension)) return true;
-            }
+        // Returns the index of an entry by name. Case insensitive.
+        Option<int> FindIndex(string_view entry) const { return _index.Find(entry); }
+
+        // Rebuilds the name index and game version. Call after modifying Entries.
+        void UpdateIndex();
 
-            return false;
+        // Returns true if any entry has the extension. Case insensitive, the leading dot is optional.
+        bool ContainsFileType(string_view extension) const {
+            return _index.ContainsExtension(extension);
         }
 
-        bool IsDescent1() const { return ContainsFileType("rdl"); }
-        bool IsDescent2() const { return ContainsFileType("rl2"); }
+        bool IsDescent1() const { return _isDescent1; }
+        bool IsDescent2() const { return _isDescent2; }
 
         // Gets the path to the corresponding mission description file
         std::filesystem::path GetMissionPath() const {
@@ -87,7 +113,8 @@ namespace Inferno {
         HogFile& operator=(const HogFile&) = delete;
         HogFile& operator=(HogFile&&) = default;
 
-        static HogFile Read(std::filesystem::path file);
+        // Reads the entry table of a hog. If map is true the archive is also mapped into memory.
+        static HogFile Read(std::filesystem::path file, bool map = false);
         static constexpr int MAX_ENTRIES = 250;
 
         List<string> GetContents() {
@@ -104,6 +131,9 @@ namespace Inferno {
         }
     };
 
+    // Size of the name and length that precede each entry
+    constexpr size_t HOG_ENTRY_HEADER_SIZE = 13 + sizeof(int32);
+
     class HogWriter {
         std::ofstream _stream;
         StreamWriter _writer;
@@ -114,7 +144,7 @@ namespace Inferno {
             _writer.WriteString("DHF", 3);
         }
 
-        void WriteEntry(string_view name, span<ubyte> data) {
+        void WriteEntry(string_view name, span<const ubyte> data) {
             if (data.empty()) return;
             if (_entries >= MAX_ENTRIES) throw Exception("Cannot have more than 250 entries!");
             _writer.WriteString(string(name), 13);
@@ -122,5 +152,52 @@ namespace Inferno {
             _writer.WriteBytes(data);
             _entries++;
         }
+
+        // Copies an entry from another hog. Uses a view of the source when it is mapped.
+        void CopyEntry(const HogFile& source, const HogEntry& entry, string_view name) {
+            if (auto view = source.ViewEntry(entry); !view.empty())
+                WriteEntry(name, view);
+            else
+                WriteEntry(name, source.ReadEntry(entry));
+        }
+    };
+
+    // Rewrites a hog with a set of changes. Unchanged entries are copied from the source as raw byte ranges
+    // instead of being read and written one at a time. Changed and new entries are appended after them.
+    class HogUpdate {
+        struct NewEntry {
+            string Name;
+            List<ubyte> Data;
+        };
+
+        HogFile& _source;
+        List<bool> _keep; // Source entries to copy
+        List<NewEntry> _entries;
+
+    public:
+        HogUpdate(HogFile& source) : _source(source), _keep(source.Entries.size(), true) {}
+
+        // Removes an entry from the output. Case insensitive.
+        void Remove(string_view name);
+
+        // Adds an entry, replacing any existing entry with the same name. Empty entries are not written.
+        void WriteEntry(string_view name, List<ubyte> data);
+
+        // Writes the result to a temporary file, then renames it over the destination.
+        // The previous file is kept using the backup extension unless it is empty.
+        // Unmaps the source if it is being replaced.
+        void Commit(const filesystem::path& path, string_view backupExtension = ".bak");
+
+        // Writes the result to TemporaryPath(path) without touching the destination.
+        // Finish with Replace(), which can run later on the thread that owns any open copy of the destination.
+        void WriteTemporary(const filesystem::path& path);
+
+        // Renames the file written by WriteTemporary() over the destination, keeping the previous file as a backup.
+        // The destination must not be mapped.
+        static void Replace(const filesystem::path& path, string_view backupExtension = ".bak");
+
+        static filesystem::path TemporaryPath(const filesystem::path& path) {
+            return File::TemporaryPath(path);
+        }
     };
-}
\ No newline at end of file
+}
@@ -7,6 +7,7 @@
 #include "Wall.h"
 #include "DataPool.h"
 #include "Segment.h"
+#include "CollisionCache.h"
 
 namespace Inferno {
     struct Matcen {
@@ -102,6 +103,32 @@ namespace Inferno {
     constexpr uint8 MaxDeltasPerLight = 255;
     constexpr auto MaxLightDeltas = 32000; // Rebirth limit. Original D2: 10000
 
+    // Microseconds spent reading each part of a level. Sections are read in parallel,
+    // so the section times can add up to more than the time spent reading them.
+    struct LevelReadTimes {
+        int64 Segments = 0, Objects = 0, Walls = 0, Triggers = 0, ReactorTriggers = 0;
+        int64 LightDeltas = 0, LightDeltaIndices = 0;
+        int64 Sections = 0; // All sections
+        int64 GeometricProps = 0; // Segment centers, normals and other derived geometry
+        int64 Total = 0;
+
+        LevelReadTimes& operator+=(const LevelReadTimes& rhs) {
+            Segments += rhs.Segments;
+            Objects += rhs.Objects;
+            Walls += rhs.Walls;
+            Triggers += rhs.Triggers;
+            ReactorTriggers += rhs.ReactorTriggers;
+            LightDeltas += rhs.LightDeltas;
+            LightDeltaIndices += rhs.LightDeltaIndices;
+            Sections += rhs.Sections;
+            GeometricProps += rhs.GeometricProps;
+            Total += rhs.Total;
+            return *this;
+        }
+
+        string Format() const;
+    };
+
     struct Level {
         string Palette = "groupa.256";
         SegID SecretExitReturn = SegID(0);
@@ -142,6 +169,10 @@ namespace Inferno {
 
         DataPool<ActiveDoor> ActiveDoors{ ActiveDoor::IsAlive, 20 };
 
+        // Triangles of every side. Derived from the segments, not saved and not copied with the level.
+        // Call Collision.Update(level) before using it after edits or copies.
+        CollisionCache Collision;
+
 
 #pragma region EditorProperties
         string FileName; // Name in hog
@@ -370,6 +401,38 @@ namespace Inferno {
             return &Objects[(int)id];
         }
 
+        // Rebuilds the object list of every segment. Needed after objects are added, removed or reordered.
+        void UpdateSegmentObjects() {
+            for (auto& seg : Segments)
+                seg.Objects.clear();
+
+            for (int id = 0; id < Objects.size(); id++) {
+                auto& obj = Objects[id];
+                if (!Object::IsAlive(obj)) continue;
+                if (auto seg = TryGetSegment(obj.Segment))
+                    seg->Objects.push_back((ObjID)id);
+            }
+        }
+
+        // Moves an object to a segment and updates the segment object lists
+        void MoveObject(ObjID id, SegID segId) {
+            auto& obj = GetObject(id);
+            if (obj.Segment == segId) return;
+
+            UnlinkObject(id);
+            obj.Segment = segId;
+
+            if (Object::IsAlive(obj))
+                if (auto seg = TryGetSegment(segId))
+                    seg->Objects.push_back(id);
+        }
+
+        // Removes an object from the object list of its segment, such as when it dies
+        void UnlinkObject(ObjID id) {
+            if (auto seg = TryGetSegment(GetObject(id).Segment))
+                std::erase(seg->Objects, id);
+        }
+
         TriggerID GetTriggerID(WallID wid) const {
             auto wall = TryGetWall(wid);
             if (!wall) return TriggerID::None;
@@ -444,6 +507,6 @@ namespace Inferno {
         bool CanAddMatcen() { return Matcens.size() < Limits.Matcens; }
 
         size_t Serialize(StreamWriter& writer);
-        static Level Deserialize(span<ubyte>);
+        static Level Deserialize(span<ubyte>, LevelReadTimes* times = nullptr);
     };
 }
\ No newline at end of file
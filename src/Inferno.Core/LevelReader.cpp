@@ -3,6 +3,8 @@
 #include "Streams.h"
 #include "Utility.h"
 #include "Pig.h"
+#include "Parallel.h"
+#include "ScopedTimer.h"
 
 namespace Inferno {
     void ReadLevelInfo(StreamReader& reader, Level& level) {
@@ -32,8 +34,34 @@ namespace Inferno {
         }
     }
 
+    namespace {
+        // On-disk layout of a light delta. Fixed stride, so the table is read in a single copy.
+        struct LightDeltaData {
+            int16 Segment;
+            ubyte Side;
+            ubyte Pad; // Probably used for dword alignment
+            ubyte Vertices[4];
+        };
+
+        struct LightDeltaIndexData {
+            int16 Segment;
+            ubyte Side;
+            ubyte Count;
+            int16 Index;
+        };
+
+        static_assert(sizeof(LightDeltaData) == 8);
+        static_assert(sizeof(LightDeltaIndexData) == 6);
+    }
+
     // Descent 1 and 2 level reader
     class LevelReader {
+        // Offsets of the game data sections
+        struct GameDataSections {
+            GameDataHeader Objects, Walls, Doors, Triggers, Links, ReactorTriggers, Matcens;
+        };
+
+        span<ubyte> _data;
         StreamReader _reader;
         int16 _gameVersion = 0;
         int _mineDataOffset;
@@ -43,9 +71,11 @@ namespace Inferno {
         GameDataHeader _deltaLights{}, _deltaLightIndices{};
 
     public:
-        LevelReader(span<ubyte> data) : _reader(data) {}
+        LevelReader(span<ubyte> data) : _data(data), _reader(data) {}
+
+        Level Read(LevelReadTimes& times) {
+            ScopedTimer totalTimer(&times.Total);
 
-        Level Read() {
             auto sig = (uint)_reader.ReadInt32();
             if (sig != MakeFourCC("LVLP"))
                 throw Exception("File is not a level (bad header)");
@@ -76,12 +106,42 @@ namespace Inferno {
             level.Version = _levelVersion;
             level.Limits = LevelLimits(_levelVersion);
             ReadLevelInfo(_reader, level);
-            ReadSegments(level);
-            ReadGameData(level);
-            ReadDynamicLights(level);
+            auto sections = ReadGameDataHeader(level);
+
+            // Once the section offsets are known the mine data and each game data section are independent.
+            // Each section reads the buffer with its own reader and writes to a different array of the level.
+            std::array<std::function<void(StreamReader&)>, 7> tasks = {
+                [&](StreamReader&) { ReadSegments(level); }, // Uses the main reader
+                [&](StreamReader& r) { ReadObjects(r, level, sections.Objects); },
+                [&](StreamReader& r) { ReadWalls(r, level, sections.Walls); },
+                [&](StreamReader& r) { ReadTriggers(r, level, sections.Triggers); },
+                [&](StreamReader& r) { ReadReactorTriggersAndMatcens(r, level, sections); },
+                [&](StreamReader& r) { ReadLightDeltas(r, level); },
+                [&](StreamReader& r) { ReadLightDeltaIndices(r, level); }
+            };
 
-            for (auto& seg : level.Segments) {
-                seg.UpdateGeometricProps(level);
+            std::array<int64*, 7> taskTimes = {
+                &times.Segments, &times.Objects, &times.Walls, &times.Triggers,
+                &times.ReactorTriggers, &times.LightDeltas, &times.LightDeltaIndices
+            };
+
+            {
+                ScopedTimer timer(&times.Sections);
+                ParallelFor(tasks.size(), 1, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) {
+                        ScopedTimer taskTimer(taskTimes[i]);
+                        StreamReader reader(_data);
+                        tasks[i](reader);
+                    }
+                });
+            }
+
+            {
+                ScopedTimer timer(&times.GeometricProps);
+                ParallelFor(level.Segments.size(), 512, [&level](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++)
+                        level.Segments[i].UpdateGeometricProps(level);
+                });
             }
 
             return level;
@@ -173,8 +233,7 @@ namespace Inferno {
             level.Vertices.resize(vertexCount);
             level.Segments.resize(segmentCount);
 
-            for (auto& v : level.Vertices)
-                v = _reader.ReadVector();
+            _reader.ReadVectors(level.Vertices);
 
             for (auto& seg : level.Segments) {
                 auto bitMask = _reader.ReadByte();
@@ -211,47 +270,47 @@ namespace Inferno {
             }
         }
 
-        Object ReadObject() {
+        Object ReadObject(StreamReader& reader) {
             Object obj{};
-            obj.Type = (ObjectType)_reader.ReadByte();
-            obj.ID = _reader.ReadByte();
-            obj.Control.Type = (ControlType)_reader.ReadByte();
-            obj.Movement.Type = (MovementType)_reader.ReadByte();
-            obj.Render.Type = (RenderType)_reader.ReadByte();
-            obj.Flags = (ObjectFlag)_reader.ReadByte();
-
-            obj.Segment = (SegID)_reader.ReadInt16();
-            obj.Position = _reader.ReadVector();
-            obj.Rotation = obj.LastRotation = _reader.ReadRotation();
-            obj.Radius = _reader.ReadFix();
-            obj.Shields = _reader.ReadFix();
-            obj.LastPosition = _reader.ReadVector();
-
-            obj.Contains.Type = (ObjectType)_reader.ReadByte();
-            obj.Contains.ID = _reader.ReadByte();
-            obj.Contains.Count = _reader.ReadByte();
+            obj.Type = (ObjectType)reader.ReadByte();
+            obj.ID = reader.ReadByte();
+            obj.Control.Type = (ControlType)reader.ReadByte();
+            obj.Movement.Type = (MovementType)reader.ReadByte();
+            obj.Render.Type = (RenderType)reader.ReadByte();
+            obj.Flags = (ObjectFlag)reader.ReadByte();
+
+            obj.Segment = (SegID)reader.ReadInt16();
+            obj.Position = reader.ReadVector();
+            obj.Rotation = obj.LastRotation = reader.ReadRotation();
+            obj.Radius = reader.ReadFix();
+            obj.Shields = reader.ReadFix();
+            obj.LastPosition = reader.ReadVector();
+
+            obj.Contains.Type = (ObjectType)reader.ReadByte();
+            obj.Contains.ID = reader.ReadByte();
+            obj.Contains.Count = reader.ReadByte();
 
             switch (obj.Movement.Type) {
                 case MovementType::Physics:
                 {
                     auto& phys = obj.Movement.Physics;
-                    phys.Velocity = _reader.ReadVector();
-                    phys.Thrust = _reader.ReadVector();
+                    phys.Velocity = reader.ReadVector();
+                    phys.Thrust = reader.ReadVector();
 
-                    phys.Mass = _reader.ReadFix();
-                    phys.Drag = _reader.ReadFix();
-                    phys.Brakes = _reader.ReadFix();
+                    phys.Mass = reader.ReadFix();
+                    phys.Drag = reader.ReadFix();
+                    phys.Brakes = reader.ReadFix();
 
-                    phys.AngularVelocity = _reader.ReadVector();
-                    phys.AngularThrust = _reader.ReadVector();
+                    phys.AngularVelocity = reader.ReadVector();
+                    phys.AngularThrust = reader.ReadVector();
 
-                    phys.TurnRoll = _reader.ReadFixAng();
-                    phys.Flags = (PhysicsFlag)_reader.ReadInt16();
+                    phys.TurnRoll = reader.ReadFixAng();
+                    phys.Flags = (PhysicsFlag)reader.ReadInt16();
                     break;
                 }
 
                 case MovementType::Spinning:
-                    obj.Movement.SpinRate = _reader.ReadVector();
+                    obj.Movement.SpinRate = reader.ReadVector();
                     break;
 
                 case MovementType::None:
@@ -265,27 +324,27 @@ namespace Inferno {
                 case ControlType::AI:
                 {
                     auto& ai = obj.Control.AI;
-                    ai.Behavior = (AIBehavior)_reader.ReadByte();
+                    ai.Behavior = (AIBehavior)reader.ReadByte();
 
                     for (auto& i : ai.Flags)
-                        i = _reader.ReadByte();
+                        i = reader.ReadByte();
 
-                    ai.HideSegment = (SegID)_reader.ReadInt16();
-                    ai.HideIndex = _reader.ReadInt16();
-                    ai.PathLength = _reader.ReadInt16();
-                    ai.CurrentPathIndex = _reader.ReadInt16();
+                    ai.HideSegment = (SegID)reader.ReadInt16();
+                    ai.HideIndex = reader.ReadInt16();
+                    ai.PathLength = reader.ReadInt16();
+                    ai.CurrentPathIndex = reader.ReadInt16();
 
                     if (_gameVersion <= 25)
-                        _reader.ReadInt32(); // These are supposed to be the path start and end for robots with the "FollowPath" AI behavior in Descent 1, but these fields are unused
+                        reader.ReadInt32(); // These are supposed to be the path start and end for robots with the "FollowPath" AI behavior in Descent 1, but these fields are unused
                     break;
                 }
 
                 case ControlType::Explosion:
                 {
                     auto& expl = obj.Control.Explosion;
-                    expl.SpawnTime = _reader.ReadFix();
-                    expl.DeleteTime = _reader.ReadFix();
-                    expl.DeleteObject = (ObjID)_reader.ReadInt16();
+                    expl.SpawnTime = reader.ReadFix();
+                    expl.DeleteTime = reader.ReadFix();
+                    expl.DeleteObject = (ObjID)reader.ReadInt16();
                     expl.NextAttach = expl.PrevAttach = expl.Parent = ObjID::None;
                     break;
                 }
@@ -293,20 +352,20 @@ namespace Inferno {
                 case ControlType::Weapon:
                 {
                     auto& weapon = obj.Control.Weapon;
-                    weapon.ParentType = (ObjectType)_reader.ReadInt16();
-                    weapon.Parent = (ObjID)_reader.ReadInt16();
-                    weapon.ParentSig = (ObjSig)_reader.ReadInt32();
+                    weapon.ParentType = (ObjectType)reader.ReadInt16();
+                    weapon.Parent = (ObjID)reader.ReadInt16();
+                    weapon.ParentSig = (ObjSig)reader.ReadInt32();
                     break;
                 }
 
                 case ControlType::Light:
-                    obj.Control.Light.Intensity = _reader.ReadFix();
+                    obj.Control.Light.Intensity = reader.ReadFix();
                     break;
 
                 case ControlType::Powerup:
                 {
                     auto& powerup = obj.Control.Powerup;
-                    powerup.Count = _reader.ReadInt32();
+                    powerup.Count = reader.ReadInt32();
                     break;
                 }
 
@@ -332,13 +391,13 @@ namespace Inferno {
                 case RenderType::Model:
                 {
                     auto& model = obj.Render.Model;
-                    model.ID = (ModelID)_reader.ReadInt32();
+                    model.ID = (ModelID)reader.ReadInt32();
 
                     for (auto& angles : model.Angles)
-                        angles = _reader.ReadAngleVec();
+                        angles = reader.ReadAngleVec();
 
-                    model.subobj_flags = _reader.ReadInt32();
-                    model.TextureOverride = (LevelTexID)_reader.ReadInt32();
+                    model.subobj_flags = reader.ReadInt32();
+                    model.TextureOverride = (LevelTexID)reader.ReadInt32();
                     break;
                 }
 
@@ -348,9 +407,9 @@ namespace Inferno {
                 case RenderType::Fireball:
                 {
                     auto& vclip = obj.Render.VClip;
-                    vclip.ID = (VClipID)_reader.ReadInt32();
-                    vclip.FrameTime = _reader.ReadFix();
-                    vclip.Frame = _reader.ReadByte();
+                    vclip.ID = (VClipID)reader.ReadInt32();
+                    vclip.FrameTime = reader.ReadFix();
+                    vclip.Frame = reader.ReadByte();
                     break;
                 }
 
@@ -366,102 +425,108 @@ namespace Inferno {
 
         void VerifyObject() {}
 
-        Wall ReadWall() {
+        Wall ReadWall(StreamReader& reader) {
             Wall w{};
-            auto segment = (SegID)_reader.ReadInt32();
-            auto side = (SideID)_reader.ReadInt32();
+            auto segment = (SegID)reader.ReadInt32();
+            auto side = (SideID)reader.ReadInt32();
             w.Tag = { segment, side };
-            w.HitPoints = _reader.ReadFix();
-            w.LinkedWall = WallID(_reader.ReadInt32());
-            w.Type = (WallType)_reader.ReadByte();
-            w.Flags = (WallFlag)_reader.ReadByte();
-            w.State = (WallState)_reader.ReadByte();
-            w.Trigger = (TriggerID)_reader.ReadByte();
-            w.Clip = (WClipID)_reader.ReadByte();
-            w.Keys = (WallKey)_reader.ReadByte();
-            w.ControllingTrigger = (TriggerID)_reader.ReadByte();
-            w.cloak_value = _reader.ReadByte();
+            w.HitPoints = reader.ReadFix();
+            w.LinkedWall = WallID(reader.ReadInt32());
+            w.Type = (WallType)reader.ReadByte();
+            w.Flags = (WallFlag)reader.ReadByte();
+            w.State = (WallState)reader.ReadByte();
+            w.Trigger = (TriggerID)reader.ReadByte();
+            w.Clip = (WClipID)reader.ReadByte();
+            w.Keys = (WallKey)reader.ReadByte();
+            w.ControllingTrigger = (TriggerID)reader.ReadByte();
+            w.cloak_value = reader.ReadByte();
             return w;
         }
 
-        void ReadTriggerTargets(std::array<Tag, MAX_TRIGGER_TARGETS>& targets) {
+        void ReadTriggerTargets(StreamReader& reader, std::array<Tag, MAX_TRIGGER_TARGETS>& targets) {
             for (auto& target : targets)
-                target.Segment = (SegID)_reader.ReadInt16();
+                target.Segment = (SegID)reader.ReadInt16();
 
             for (auto& target : targets)
-                target.Side = (SideID)_reader.ReadInt16();
+                target.Side = (SideID)reader.ReadInt16();
         }
 
-        Trigger ReadTrigger() {
+        Trigger ReadTrigger(StreamReader& reader) {
             Trigger trigger = {};
 
             if (_levelVersion > 1) {
                 // Descent 2
-                trigger.Type = (TriggerType)_reader.ReadByte();
-                trigger.Flags = (TriggerFlag)_reader.ReadByte();
-                trigger.Targets.Count(_reader.ReadByte());
-                /*trigger.linkNum = */_reader.ReadByte();
-                trigger.Value = _reader.ReadInt32();
-                trigger.Time = _reader.ReadInt32();
+                trigger.Type = (TriggerType)reader.ReadByte();
+                trigger.Flags = (TriggerFlag)reader.ReadByte();
+                trigger.Targets.Count(reader.ReadByte());
+                /*trigger.linkNum = */reader.ReadByte();
+                trigger.Value = reader.ReadInt32();
+                trigger.Time = reader.ReadInt32();
             }
             else {
                 // Descent 1
-                trigger.Type = (TriggerType)_reader.ReadByte();
-                trigger.FlagsD1 = (TriggerFlagD1)_reader.ReadInt16();
-                trigger.Value = _reader.ReadInt32();
-                trigger.Time = _reader.ReadInt32();
-                /*trigger.linkNum = */_reader.ReadByte();
-                trigger.Targets.Count(_reader.ReadInt16());
+                trigger.Type = (TriggerType)reader.ReadByte();
+                trigger.FlagsD1 = (TriggerFlagD1)reader.ReadInt16();
+                trigger.Value = reader.ReadInt32();
+                trigger.Time = reader.ReadInt32();
+                /*trigger.linkNum = */reader.ReadByte();
+                trigger.Targets.Count(reader.ReadInt16());
             }
 
-            ReadTriggerTargets(trigger.Targets.data());
+            ReadTriggerTargets(reader, trigger.Targets.data());
             return trigger;
         }
 
-        Matcen ReadMatcen() {
+        Matcen ReadMatcen(StreamReader& reader) {
             Matcen m;
-            m.Robots = _reader.ReadInt32();
+            m.Robots = reader.ReadInt32();
             if (_gameVersion > 25)
-                m.Robots2 = _reader.ReadInt32();
-            m.HitPoints = _reader.ReadInt32();
-            m.Interval = _reader.ReadInt32();
-            m.Segment = (SegID)_reader.ReadInt16();
-            m.Producer = _reader.ReadInt16();
+                m.Robots2 = reader.ReadInt32();
+            m.HitPoints = reader.ReadInt32();
+            m.Interval = reader.ReadInt32();
+            m.Segment = (SegID)reader.ReadInt16();
+            m.Producer = reader.ReadInt16();
             return m;
         }
 
-        void ReadDynamicLights(Level& level) {
-            if (_deltaLights.Offset != -1) {
-                _reader.Seek(_deltaLights.Offset);
-
-                for (int32 i = 0; i < _deltaLights.Count; i++) {
-                    auto& delta = level.LightDeltas.emplace_back();
-                    delta.Tag.Segment = (SegID)_reader.ReadInt16();
-                    delta.Tag.Side = (SideID)_reader.ReadByte();
-                    _reader.ReadByte(); // dummy - probably used for dword alignment
-
-                    for (int j = 0; j < 4; j++) {
-                        // Vertex deltas scaled by 2048 - see DL_SCALE in segment.h
-                        auto light = FixToFloat(fix(_reader.ReadByte() * 2048));
-                        delta.Color[j] = Color(light, light, light, 0.0f);
-                    }
+        void ReadLightDeltas(StreamReader& reader, Level& level) const {
+            if (_deltaLights.Offset == -1) return;
+            reader.Seek(_deltaLights.Offset);
+            auto deltas = reader.ReadArray<LightDeltaData>(std::max(_deltaLights.Count, 0));
+            level.LightDeltas.resize(deltas.size());
+
+            for (size_t i = 0; i < deltas.size(); i++) {
+                auto& src = deltas[i];
+                auto& delta = level.LightDeltas[i];
+                delta.Tag.Segment = (SegID)src.Segment;
+                delta.Tag.Side = (SideID)src.Side;
+
+                for (int j = 0; j < 4; j++) {
+                    // Vertex deltas scaled by 2048 - see DL_SCALE in segment.h
+                    auto light = FixToFloat(fix(src.Vertices[j] * 2048));
+                    delta.Color[j] = Color(light, light, light, 0.0f);
                 }
             }
+        }
 
-            if (_deltaLightIndices.Offset != -1) {
-                _reader.Seek(_deltaLightIndices.Offset);
-
-                for (int32 i = 0; i < _deltaLightIndices.Count; i++) {
-                    auto& index = level.LightDeltaIndices.emplace_back();
-                    index.Tag.Segment = (SegID)_reader.ReadInt16();
-                    index.Tag.Side = (SideID)_reader.ReadByte();
-                    index.Count = _reader.ReadByte();
-                    index.Index = _reader.ReadInt16();
-                }
+        void ReadLightDeltaIndices(StreamReader& reader, Level& level) const {
+            if (_deltaLightIndices.Offset == -1) return;
+            reader.Seek(_deltaLightIndices.Offset);
+            auto indices = reader.ReadArray<LightDeltaIndexData>(std::max(_deltaLightIndices.Count, 0));
+            level.LightDeltaIndices.resize(indices.size());
+
+            for (size_t i = 0; i < indices.size(); i++) {
+                auto& src = indices[i];
+                auto& index = level.LightDeltaIndices[i];
+                index.Tag.Segment = (SegID)src.Segment;
+                index.Tag.Side = (SideID)src.Side;
+                index.Count = src.Count;
+                index.Index = src.Index;
             }
         }
 
-        void ReadGameData(Level& level) {
+        // Reads the game data header and sizes the level arrays. Returns the section offsets.
+        GameDataSections ReadGameDataHeader(Level& level) {
             _reader.Seek(_gameDataOffset);
 
             auto sig = _reader.ReadInt16();
@@ -482,18 +547,19 @@ namespace Inferno {
                 return GameDataHeader{ _reader.ReadInt32(), _reader.ReadInt32(), _reader.ReadInt32() };
             };
 
-            auto objects = ReadHeader();
-            auto walls = ReadHeader();
-            auto doors = ReadHeader();
-            auto triggers = ReadHeader();
-            auto links = ReadHeader();
-            auto reactorTriggers = ReadHeader();
-            auto matcens = ReadHeader();
+            GameDataSections sections;
+            sections.Objects = ReadHeader();
+            sections.Walls = ReadHeader();
+            sections.Doors = ReadHeader();
+            sections.Triggers = ReadHeader();
+            sections.Links = ReadHeader();
+            sections.ReactorTriggers = ReadHeader();
+            sections.Matcens = ReadHeader();
 
-            level.Walls.resize(walls.Count);
-            level.Triggers.resize(triggers.Count);
-            level.Objects.resize(objects.Count);
-            level.Matcens.resize(matcens.Count);
+            level.Walls.resize(sections.Walls.Count);
+            level.Triggers.resize(sections.Triggers.Count);
+            level.Objects.resize(sections.Objects.Count);
+            level.Matcens.resize(sections.Matcens.Count);
 
             if (_gameVersion >= 29) {
                 _deltaLightIndices = ReadHeader();
@@ -509,41 +575,56 @@ namespace Inferno {
             //for (auto& pof : level.Pofs)
             //    pof = _reader.ReadString(13);
 
-            // Objects
-            _reader.Seek(objects.Offset);
+            return sections;
+        }
+
+        void ReadObjects(StreamReader& reader, Level& level, const GameDataHeader& objects) {
+            reader.Seek(objects.Offset);
 
             for (auto& obj : level.Objects) {
-                obj = ReadObject();
+                obj = ReadObject(reader);
                 VerifyObject(); // TODO: Actually verify the object
             }
+        }
 
-            // Walls
-            if (walls.Offset != -1) {
-                _reader.Seek(walls.Offset);
-                for (auto& wall : level.Walls)
-                    wall = ReadWall();
-            }
+        void ReadWalls(StreamReader& reader, Level& level, const GameDataHeader& walls) {
+            if (walls.Offset == -1) return;
+            reader.Seek(walls.Offset);
+            for (auto& wall : level.Walls)
+                wall = ReadWall(reader);
+        }
 
-            if (triggers.Offset != -1) {
-                _reader.Seek(triggers.Offset);
-                for (auto& t : level.Triggers)
-                    t = ReadTrigger();
-            }
+        void ReadTriggers(StreamReader& reader, Level& level, const GameDataHeader& triggers) {
+            if (triggers.Offset == -1) return;
+            reader.Seek(triggers.Offset);
+            for (auto& t : level.Triggers)
+                t = ReadTrigger(reader);
+        }
 
-            // Control center triggers
-            if (reactorTriggers.Offset != -1) {
-                _reader.Seek(reactorTriggers.Offset);
-                level.ReactorTriggers.Count(_reader.ReadInt16());
-                ReadTriggerTargets(level.ReactorTriggers.data());
+        // Matcens are stored directly after the control center triggers
+        void ReadReactorTriggersAndMatcens(StreamReader& reader, Level& level, const GameDataSections& sections) {
+            if (sections.ReactorTriggers.Offset != -1) {
+                reader.Seek(sections.ReactorTriggers.Offset);
+                level.ReactorTriggers.Count(reader.ReadInt16());
+                ReadTriggerTargets(reader, level.ReactorTriggers.data());
+            }
+            else if (sections.Matcens.Offset != -1) {
+                reader.Seek(sections.Matcens.Offset);
             }
 
             for (auto& m : level.Matcens)
-                m = ReadMatcen();
+                m = ReadMatcen(reader);
         }
     };
 
-    Level Level::Deserialize(span<ubyte> data) {
+    Level Level::Deserialize(span<ubyte> data, LevelReadTimes* times) {
+        LevelReadTimes localTimes;
         LevelReader reader(data);
-        return reader.Read();
+        return reader.Read(times ? *times : localTimes);
+    }
+
+    string LevelReadTimes::Format() const {
+        return fmt::format("{} us. Sections {} us (segments {}, objects {}, walls {}, triggers {}, reactor triggers {}, light deltas {}, light delta indices {}). Geometry {} us",
+                           Total, Sections, Segments, Objects, Walls, Triggers, ReactorTriggers, LightDeltas, LightDeltaIndices, GeometricProps);
     }
 }
\ No newline at end of file
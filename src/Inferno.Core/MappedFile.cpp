@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace Inferno {
+    MappedFile::MappedFile(const filesystem::path& path) {
+        auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE)
+            throw Exception(fmt::format("Unable to open file for mapping: {}", path.string()));
+
+        _file = file;
+
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            throw Exception(fmt::format("Unable to read file size: {}", path.string()));
+        }
+
+        _size = (size_t)size.QuadPart;
+        if (_size == 0) return; // Empty files can't be mapped
+
+        _mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!_mapping) {
+            CloseHandle(file);
+            throw Exception(fmt::format("Unable to map file: {}", path.string()));
+        }
+
+        _data = (const ubyte*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!_data) {
+            CloseHandle(_mapping);
+            CloseHandle(file);
+            throw Exception(fmt::format("Unable to map view of file: {}", path.string()));
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        if (_data) UnmapViewOfFile(_data);
+        if (_mapping) CloseHandle(_mapping);
+        if (_file) CloseHandle(_file);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Types.h"
+
+namespace Inferno {
+    // A read-only file mapped into memory. Views returned from it are valid for the lifetime of the mapping.
+    class MappedFile {
+        void* _file = nullptr; // HANDLE
+        void* _mapping = nullptr; // HANDLE
+        const ubyte* _data = nullptr;
+        size_t _size = 0;
+    public:
+        // Maps an existing file. Throws if the file cannot be opened.
+        MappedFile(const filesystem::path& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile(MappedFile&&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&&) = delete;
+
+        span<const ubyte> Data() const { return { _data, _size }; }
+        size_t Size() const { return _size; }
+
+        // Returns a view of a range in the file. Throws if the range is outside of the file.
+        span<const ubyte> Slice(size_t offset, size_t length) const {
+            if (offset > _size || length > _size - offset)
+                throw Exception("Mapped file range is out of bounds");
+
+            return { _data + offset, length };
+        }
+    };
+}
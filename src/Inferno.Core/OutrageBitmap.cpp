@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "OutrageBitmap.h"
+#include "Parallel.h"
+#include <emmintrin.h>
 
 namespace Inferno::Outrage {
     enum ImageType {
@@ -25,40 +27,77 @@ namespace Inferno::Outrage {
         BITMAP_FORMAT_4444 = 1,
     };
 
-    constexpr int Conv5to8(int n) { return (n << 3) | (n >> 2); }
-
-    List<uint> Decompress(span<ushort> data, int width, int height, ImageType type) {
-        List<uint> img(width * height);
-        const int lastrow = (width - 1) * height;
-
-        for (int ofs = 0; ofs <= lastrow; ofs += width) {
-            if (type == OUTRAGE_4444_COMPRESSED_MIPPED) {
-                for (int x = 0; x < width; x++) {
-                    const ushort n = data[ofs + x];
-                    //const int a = ((n >> 12) & 0x0f) * 0x11;
-                    constexpr int a = 0xff; // ignore alpha for now. it should be extracted as a specular mask
-                    const int r = ((n >> 8) & 0x0f) * 0x11;
-                    const int g = ((n >> 4) & 0x0f) * 0x11;
-                    const int b = (n & 0x0f) * 0x11;
-                    img[ofs + x] = a << 24 | b << 16 | g << 8 | r;
-                }
-            }
-            else {
-                for (int x = 0; x < width; x++) {
-                    const ushort n = data[ofs + x];
-                    img[ofs + x] =
-                        ((n & 0x8000) * 0x1fe00) |
-                        (Conv5to8((n & 0x7c00) >> 10) << 0) |
-                        (Conv5to8((n & 0x03e0) >> 5) << 8) |
-                        (Conv5to8((n & 0x001f) >> 0) << 16);
-                }
+    constexpr uint Conv5to8(uint n) { return (n << 3) | (n >> 2); }
+    constexpr uint Conv4to8(uint n) { return n * 0x11; }
+
+    constexpr uint Convert1555(ushort n) {
+        return (n & 0x8000) * 0x1fe00 |
+            Conv5to8((n & 0x7c00) >> 10) << 0 |
+            Conv5to8((n & 0x03e0) >> 5) << 8 |
+            Conv5to8((n & 0x001f) >> 0) << 16;
+    }
+
+    // Alpha is stored separately as a specular mask
+    constexpr uint Convert4444(ushort n) {
+        return 0xffu << 24 |
+            Conv4to8((n >> 0) & 0x0f) << 16 |
+            Conv4to8((n >> 4) & 0x0f) << 8 |
+            Conv4to8((n >> 8) & 0x0f);
+    }
+
+    // Packs 16-bit channels of eight pixels into RGBA
+    void StoreRGBA(uint* dest, __m128i r, __m128i g, __m128i b, __m128i a) {
+        auto rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        auto ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+        _mm_storeu_si128((__m128i*)dest, _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i*)(dest + 4), _mm_unpackhi_epi16(rg, ba));
+    }
+
+    void Decompress1555(span<const ushort> src, uint* dest) {
+        const auto mask = _mm_set1_epi16(0x1f);
+        const auto alpha = _mm_set1_epi16(0xff);
+        auto conv5to8 = [](__m128i x) { return _mm_or_si128(_mm_slli_epi16(x, 3), _mm_srli_epi16(x, 2)); };
+
+        size_t i = 0;
+        for (; i + 8 <= src.size(); i += 8) {
+            auto n = _mm_loadu_si128((const __m128i*)&src[i]);
+            auto r = conv5to8(_mm_and_si128(_mm_srli_epi16(n, 10), mask));
+            auto g = conv5to8(_mm_and_si128(_mm_srli_epi16(n, 5), mask));
+            auto b = conv5to8(_mm_and_si128(n, mask));
+            auto a = _mm_and_si128(_mm_srai_epi16(n, 15), alpha); // Sign extend the alpha bit
+            StoreRGBA(dest + i, r, g, b, a);
+        }
+
+        for (; i < src.size(); i++)
+            dest[i] = Convert1555(src[i]);
+    }
+
+    void Decompress4444(span<const ushort> src, uint* dest, ubyte* specular) {
+        const auto mask = _mm_set1_epi16(0x0f);
+        const auto alpha = _mm_set1_epi16(0xff);
+        auto conv4to8 = [](__m128i x) { return _mm_or_si128(x, _mm_slli_epi16(x, 4)); };
+
+        size_t i = 0;
+        for (; i + 8 <= src.size(); i += 8) {
+            auto n = _mm_loadu_si128((const __m128i*)&src[i]);
+            auto r = conv4to8(_mm_and_si128(_mm_srli_epi16(n, 8), mask));
+            auto g = conv4to8(_mm_and_si128(_mm_srli_epi16(n, 4), mask));
+            auto b = conv4to8(_mm_and_si128(n, mask));
+            StoreRGBA(dest + i, r, g, b, alpha);
+
+            if (specular) {
+                auto s = conv4to8(_mm_srli_epi16(n, 12));
+                _mm_storel_epi64((__m128i*)(specular + i), _mm_packus_epi16(s, s));
             }
         }
 
-        return img;
+        for (; i < src.size(); i++) {
+            dest[i] = Convert4444(src[i]);
+            if (specular) specular[i] = (ubyte)Conv4to8(src[i] >> 12);
+        }
     }
 
-    Bitmap Bitmap::Read(StreamReader& r) {
+    Bitmap Bitmap::Read(StreamReader& r, bool specular) {
         auto imageIdLen = r.ReadByte();
         auto colorMapType = r.ReadByte();
         auto imageType = r.ReadByte();
@@ -74,7 +113,7 @@ namespace Inferno::Outrage {
 
         ogf.Name = r.ReadCString(BITMAP_NAME_LEN);
         auto mipLevels = r.ReadByte();
-        if (mipLevels > 20) throw ("Invalid mip levels");
+        if (mipLevels > 20) throw Exception("Invalid mip levels");
         ogf.Mips.resize(mipLevels);
 
         for (int i = 0; i < 9; i++)
@@ -94,17 +133,26 @@ namespace Inferno::Outrage {
         for (int i = 0; i < imageIdLen; i++)
             r.ReadByte();
 
-        int mipLevel = 0;
-        for (auto& mip : ogf.Mips) {
-            auto sz = 1 << mipLevel++;
-            auto width = ogf.Width / sz;
-            auto height = ogf.Height / sz;
+        if (ogf.Width < 0 || ogf.Height < 0)
+            throw Exception("Invalid bitmap size");
+
+        // Lay out every mip in one buffer
+        size_t pixelCount = 0;
+        for (int i = 0; i < ogf.Mips.size(); i++) {
+            auto& mip = ogf.Mips[i];
+            mip.Width = ogf.Width / (1 << i);
+            mip.Height = ogf.Height / (1 << i);
+            mip.Offset = pixelCount;
+            pixelCount += (size_t)mip.Width * mip.Height;
+        }
 
-            List<ushort> data(width * height);
+        List<ushort> data(pixelCount);
 
-            int count = 0;
+        for (auto& mip : ogf.Mips) {
+            size_t count = mip.Offset;
+            auto end = mip.Offset + (size_t)mip.Width * mip.Height;
 
-            while (count < data.size()) {
+            while (count < end) {
                 auto cmd = r.ReadByte();
                 ushort pixel = r.ReadUInt16();
 
@@ -112,21 +160,32 @@ namespace Inferno::Outrage {
                     data[count++] = pixel;
                 }
                 else if (cmd >= 2 && cmd <= 250) {
-                    for (int i = 0; i < cmd; i++)
-                        data[count++] = pixel;
+                    if (cmd > end - count)
+                        throw Exception("Compressed run is larger than the mip");
+
+                    std::fill_n(&data[count], cmd, pixel);
+                    count += cmd;
                 }
                 else {
                     throw Exception("Invalid compression command");
                 }
             }
+        }
 
-            mip = Decompress(data, width, height, (ImageType)ogf.Type);
+        ogf.Data.resize(pixelCount);
+
+        if (imageType == OUTRAGE_4444_COMPRESSED_MIPPED) {
+            if (specular) ogf.Specular.resize(pixelCount);
+            Decompress4444(data, ogf.Data.data(), specular ? ogf.Specular.data() : nullptr);
+        }
+        else {
+            Decompress1555(data, ogf.Data.data());
         }
 
         return ogf;
     }
 
-    VClip VClip::Read(StreamReader& r) {
+    VClip VClip::Read(StreamReader& r, bool specular) {
         VClip vc{};
         ubyte start_val = r.ReadByte();
 
@@ -147,7 +206,7 @@ namespace Inferno::Outrage {
         }
 
         for (int i = 0; i < vc.Frames.size(); i++) {
-            vc.Frames[i] = Bitmap::Read(r);
+            vc.Frames[i] = Bitmap::Read(r, specular);
         }
 
         // also supports resizing 
@@ -161,4 +220,33 @@ namespace Inferno::Outrage {
 
         return vc;
     }
+
+    namespace {
+        template<class T>
+        List<Option<T>> ReadParallel(span<const List<ubyte>> files, bool specular) {
+            List<Option<T>> results(files.size());
+
+            ParallelFor(files.size(), 1, [&](size_t begin, size_t end) {
+                for (auto i = begin; i < end; i++) {
+                    try {
+                        StreamReader reader(files[i]);
+                        results[i] = T::Read(reader, specular);
+                    }
+                    catch (const std::exception&) {
+                        // Leave empty so the caller can report it
+                    }
+                }
+            });
+
+            return results;
+        }
+    }
+
+    List<Option<Bitmap>> ReadBitmaps(span<const List<ubyte>> files, bool specular) {
+        return ReadParallel<Bitmap>(files, specular);
+    }
+
+    List<Option<VClip>> ReadVClips(span<const List<ubyte>> files, bool specular) {
+        return ReadParallel<VClip>(files, specular);
+    }
 }
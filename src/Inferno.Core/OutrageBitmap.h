@@ -5,13 +5,33 @@
 namespace Inferno::Outrage {
     // Descent 3 Outrage Graphics File (OGF)
     struct Bitmap {
+        struct Mip {
+            size_t Offset = 0; // Pixel offset into Data
+            int Width = 0, Height = 0;
+        };
+
         int Width = 0, Height = 0;
         int Type = 0;
-        List<List<uint>> Mips;
+        List<uint> Data; // RGBA pixels of every mip level in a single allocation, largest first
+        List<ubyte> Specular; // Specular mask from the alpha of 4444 bitmaps. Same layout as Data. Only filled when requested.
+        List<Mip> Mips;
         int BitsPerPixel = 0;
         string Name;
-        
-        static Bitmap Read(StreamReader& r); // Read OGF
+
+        // Returns the pixels of a mip level
+        span<const uint> GetMip(int level) const {
+            auto& mip = Mips[level];
+            return { Data.data() + mip.Offset, (size_t)mip.Width * mip.Height };
+        }
+
+        span<const ubyte> GetSpecular(int level) const {
+            if (Specular.empty()) return {};
+            auto& mip = Mips[level];
+            return { Specular.data() + mip.Offset, (size_t)mip.Width * mip.Height };
+        }
+
+        // Read OGF. Specular extracts the alpha of 4444 bitmaps into the specular mask.
+        static Bitmap Read(StreamReader& r, bool specular = false);
     };
 
     // Descent 3 VClips are bitmaps with an extra header (OAF)
@@ -22,6 +42,12 @@ namespace Inferno::Outrage {
         bool PingPong;
         string FileName;
 
-        static VClip Read(StreamReader& r);
+        static VClip Read(StreamReader& r, bool specular = false);
     };
-}
\ No newline at end of file
+
+    // Decodes OGF files in parallel. Files that fail to decode are returned empty.
+    List<Option<Bitmap>> ReadBitmaps(span<const List<ubyte>> files, bool specular = false);
+
+    // Decodes OAF files in parallel. Files that fail to decode are returned empty.
+    List<Option<VClip>> ReadVClips(span<const List<ubyte>> files, bool specular = false);
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include "Types.h"
+
+namespace Inferno {
+    // Splits [0, count) into batches and calls fn(begin, end) for each of them on all hardware threads,
+    // including the calling thread. Returns after every batch is finished.
+    // The first exception thrown by fn stops the remaining batches and is rethrown on the calling thread.
+    template<class Fn>
+    void ParallelFor(size_t count, size_t batchSize, Fn&& fn) {
+        if (count == 0) return;
+        batchSize = std::max(batchSize, (size_t)1);
+
+        std::atomic<size_t> next = 0;
+        std::exception_ptr error;
+        std::mutex errorLock;
+
+        auto worker = [&] {
+            try {
+                while (true) {
+                    auto begin = next.fetch_add(batchSize);
+                    if (begin >= count) break;
+                    fn(begin, std::min(begin + batchSize, count));
+                }
+            }
+            catch (...) {
+                std::scoped_lock lock(errorLock);
+                if (!error) error = std::current_exception();
+                next = count; // Stop the other threads
+            }
+        };
+
+        auto batches = (count + batchSize - 1) / batchSize;
+        auto threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), batches);
+        List<std::thread> threads;
+        for (size_t i = 1; i < threadCount; i++)
+            threads.emplace_back(worker);
+
+        worker();
+
+        for (auto& thread : threads)
+            thread.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // Runs ParallelFor loops on threads that are created once and sleep between loops.
+    // Use for loops that run too often, or do too little work, to create threads every time.
+    // Only one loop can run at a time.
+    class WorkerPool {
+        List<std::thread> _threads;
+        std::mutex _lock;
+        std::condition_variable _wake, _done;
+        std::function<void()> _work; // Body of the current loop
+        uint64 _generation = 0; // Incremented for each loop
+        size_t _active = 0; // Workers that haven't finished the current loop
+        bool _stop = false;
+
+        void WorkerMain() {
+            uint64 generation = 0;
+
+            while (true) {
+                {
+                    std::unique_lock lock(_lock);
+                    _wake.wait(lock, [&] { return _stop || _generation != generation; });
+                    if (_stop) return;
+                    generation = _generation;
+                }
+
+                _work();
+
+                std::scoped_lock lock(_lock);
+                if (--_active == 0) _done.notify_one();
+            }
+        }
+
+    public:
+        // The calling thread also runs batches, so the default uses one less thread than the hardware has
+        explicit WorkerPool(size_t threads = std::max(std::thread::hardware_concurrency(), 1u) - 1) {
+            for (size_t i = 0; i < threads; i++)
+                _threads.emplace_back([this] { WorkerMain(); });
+        }
+
+        ~WorkerPool() {
+            {
+                std::scoped_lock lock(_lock);
+                _stop = true;
+            }
+
+            _wake.notify_all();
+            for (auto& thread : _threads)
+                thread.join();
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool(WorkerPool&&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+        WorkerPool& operator=(WorkerPool&&) = delete;
+
+        size_t ThreadCount() const { return _threads.size() + 1; }
+
+        // Same as Inferno::ParallelFor, but on the pool's threads
+        template<class Fn>
+        void ParallelFor(size_t count, size_t batchSize, Fn&& fn) {
+            if (count == 0) return;
+            batchSize = std::max(batchSize, (size_t)1);
+
+            std::atomic<size_t> next = 0;
+            std::exception_ptr error;
+            std::mutex errorLock;
+
+            auto worker = [&] {
+                try {
+                    while (true) {
+                        auto begin = next.fetch_add(batchSize);
+                        if (begin >= count) break;
+                        fn(begin, std::min(begin + batchSize, count));
+                    }
+                }
+                catch (...) {
+                    std::scoped_lock lock(errorLock);
+                    if (!error) error = std::current_exception();
+                    next = count; // Stop the other threads
+                }
+            };
+
+            if (!_threads.empty() && count > batchSize) {
+                {
+                    std::scoped_lock lock(_lock);
+                    _work = worker;
+                    _active = _threads.size();
+                    _generation++;
+                }
+
+                _wake.notify_all();
+                worker();
+
+                std::unique_lock lock(_lock);
+                _done.wait(lock, [this] { return _active == 0; });
+                _work = {};
+            }
+            else {
+                worker();
+            }
+
+            if (error)
+                std::rethrow_exception(error);
+        }
+    };
+
+    // Runs tasks on a fixed number of threads. Each worker has its own queue. Workers take the newest task from
+    // their own queue and steal the oldest task from another worker when theirs is empty.
+    // Queue related tasks on the same worker so they tend to run on the same thread and share its caches.
+    template<class TTask>
+    class WorkStealingScheduler {
+        struct Queue {
+            std::mutex Lock;
+            std::deque<TTask> Tasks;
+        };
+
+        List<Ptr<Queue>> _queues;
+        std::atomic<size_t> _pending = 0; // Queued and running tasks
+        std::atomic<bool> _stop = false;
+
+        Option<TTask> Pop(size_t worker) {
+            auto& queue = *_queues[worker];
+            std::scoped_lock lock(queue.Lock);
+            if (queue.Tasks.empty()) return {};
+            auto task = std::move(queue.Tasks.back());
+            queue.Tasks.pop_back();
+            return task;
+        }
+
+        Option<TTask> Steal(size_t worker) {
+            for (size_t i = 1; i < _queues.size(); i++) {
+                auto& queue = *_queues[(worker + i) % _queues.size()];
+                std::scoped_lock lock(queue.Lock);
+                if (queue.Tasks.empty()) continue;
+                auto task = std::move(queue.Tasks.front());
+                queue.Tasks.pop_front();
+                return task;
+            }
+
+            return {};
+        }
+
+    public:
+        explicit WorkStealingScheduler(size_t workers) {
+            for (size_t i = 0; i < std::max(workers, (size_t)1); i++)
+                _queues.push_back(MakePtr<Queue>());
+        }
+
+        size_t WorkerCount() const { return _queues.size(); }
+
+        // Queues a task on a worker. Can be called by running tasks.
+        void Push(size_t worker, TTask task) {
+            auto& queue = *_queues[worker % _queues.size()];
+            _pending++;
+            std::scoped_lock lock(queue.Lock);
+            queue.Tasks.push_back(std::move(task));
+        }
+
+        // Discards the queued tasks. Tasks that are already running finish normally.
+        void Stop() { _stop = true; }
+
+        // Calls fn(task, worker) for every task, including ones queued while running, and returns once they finish.
+        // The calling thread is used as worker 0. The first exception thrown by fn stops the scheduler and is rethrown.
+        template<class Fn>
+        void Run(Fn&& fn) {
+            std::exception_ptr error;
+            std::mutex errorLock;
+
+            auto worker = [&](size_t index) {
+                try {
+                    while (!_stop) {
+                        auto task = Pop(index);
+                        if (!task) task = Steal(index);
+
+                        if (!task) {
+                            if (_pending == 0) break; // Nothing is running that could queue more work
+                            std::this_thread::yield();
+                            continue;
+                        }
+
+                        fn(*task, index);
+                        _pending--;
+                    }
+                }
+                catch (...) {
+                    std::scoped_lock lock(errorLock);
+                    if (!error) error = std::current_exception();
+                    _stop = true;
+                }
+            };
+
+            List<std::thread> threads;
+            for (size_t i = 1; i < _queues.size(); i++)
+                threads.emplace_back(worker, i);
+
+            worker(0);
+
+            for (auto& thread : threads)
+                thread.join();
+
+            if (error)
+                std::rethrow_exception(error);
+        }
+    };
+
+    // Hands the latest value from one producer thread to one consumer thread without locking.
+    // The producer and consumer each own a slot and swap it with a shared middle slot, so neither ever waits
+    // and the consumer never reads a slot that is being written. Values the consumer misses are overwritten.
+    template<class T>
+    class TripleBuffer {
+        static constexpr uint8 NEW_VALUE = 1 << 2; // Set when the middle slot holds a value the consumer hasn't taken
+
+        Array<T, 3> _slots{};
+        std::atomic<uint8> _middle = 1; // Shared slot and NEW_VALUE
+        uint8 _back = 0; // Owned by the producer
+        uint8 _front = 2; // Owned by the consumer
+
+    public:
+        // Producer: slot to write the next value into
+        T& Back() { return _slots[_back]; }
+
+        // Producer: makes the back slot the latest value
+        void Publish() {
+            _back = _middle.exchange(_back | NEW_VALUE, std::memory_order_acq_rel) & ~NEW_VALUE;
+        }
+
+        // Consumer: returns the latest value if one was published since the last call, otherwise null.
+        // The value stays valid until the next call.
+        T* TryTake() {
+            if (!(_middle.load(std::memory_order_relaxed) & NEW_VALUE)) return nullptr;
+            _front = _middle.exchange(_front, std::memory_order_acq_rel) & ~NEW_VALUE;
+            return &_slots[_front];
+        }
+    };
+}
@@ -4,6 +4,7 @@
 #include "Utility.h"
 #include "Sound.h"
 #include <ranges>
+#include "Parallel.h"
 
 namespace Inferno {
     constexpr auto PIGFILE_VERSION = 2;
@@ -85,11 +86,12 @@ namespace Inferno {
             pigEntries[(int)id] = ReadD2BitmapHeader(reader, id);
 
         auto dataStart = reader.Position();
+        auto entries = Seq::map(ids, [&](TexID id) { return pigEntries[(int)id]; });
+        auto decoded = ReadBitmaps(data, dataStart, entries, palette);
 
-        for (auto& id : ids) {
-            auto& entry = pigEntries[(int)id];
-            bitmaps[id] = ReadBitmapEntry(reader, dataStart, entry, palette);
-            bitmaps[id].Info.Custom = true;
+        for (size_t i = 0; i < ids.size(); i++) {
+            decoded[i].Info.Custom = true;
+            bitmaps[ids[i]] = std::move(decoded[i]);
         }
 
         return bitmaps;
@@ -124,10 +126,11 @@ namespace Inferno {
         auto dataStart = reader.Position();
 
         Dictionary<TexID, PigBitmap> bitmaps;
+        auto decoded = ReadBitmaps(data, dataStart, entries, palette);
 
-        for (auto& entry : entries) {
-            bitmaps[entry.ID] = ReadBitmapEntry(reader, dataStart, entry, palette);
-            bitmaps[entry.ID].Info.Custom = true;
+        for (auto& bmp : decoded) {
+            bmp.Info.Custom = true;
+            bitmaps[bmp.Info.ID] = std::move(bmp);
         }
 
         // There's sound data here but we don't care
@@ -159,23 +162,6 @@ namespace Inferno {
         return pig;
     }
 
-    // Permanently flips image data along Y axis
-    void FlipBitmapY(PigBitmap& bmp) {
-        List<ubyte> buffer(bmp.Info.Width * bmp.Info.Height * 4);
-        List<ubyte> indexBuffer(bmp.Info.Width * bmp.Info.Height);
-        //const int rowLen = bmp.Info.Width * 4;
-        int i = 0;
-        for (int row = bmp.Info.Height - 1; row >= 0; row--) {
-            auto offset = (uint)row * bmp.Info.Width;
-            memcpy(&buffer[i * 4], &bmp.Data[offset], bmp.Info.Width * 4);
-            memcpy(&indexBuffer[i], &bmp.Indexed[offset], bmp.Info.Width);
-            i += bmp.Info.Width;
-        }
-
-        memcpy(bmp.Data.data(), buffer.data(), buffer.size());
-        memcpy(bmp.Indexed.data(), indexBuffer.data(), indexBuffer.size());
-    }
-
     void PigBitmap::ExtractMask() {
         if (!Info.SuperTransparent) return;
         Mask.resize(Data.size());
@@ -200,95 +186,170 @@ namespace Inferno {
         }
     }
 
-    PigBitmap ReadRLE(StreamReader& reader,
-                      size_t dataStart,
-                      const Palette& palette,
-                      const PigEntry& entry) {
-        PigBitmap bmp(entry);
-        reader.Seek(dataStart + entry.DataOffset);
-        /*auto size = */
-        reader.ReadInt32();
-
-        List<uint16> rowSize(bmp.Info.Height);
-        List<uint8> buffer(bmp.Info.Width * 3);
-        bmp.Data.resize((size_t)bmp.Info.Width * bmp.Info.Height);
-        bmp.Indexed.resize((size_t)bmp.Info.Width * bmp.Info.Height);
-
-        if (entry.UsesBigRle) {
-            // long scan lines (>= 256 bytes), row lengths are stored as shorts
-            reader.ReadBytes(rowSize.data(), entry.Height * sizeof(int16));
-        }
-        else {
-            // row lengths are stored as bytes
-            for (int i = 0; i < entry.Height; i++)
-                rowSize[i] = reader.ReadByte() & 0xff;
-        }
-
-        for (int y = entry.Height - 1, row = 0; y >= 0; y--, row++) {
-            reader.ReadBytes(buffer.data(), rowSize[row]);
-            int h = y * entry.Width;
-            for (int x = 0, offset = 0; x < entry.Width;) {
-                auto palIndex = buffer[offset++]; // palette index
-
-                if (IsRleCode(palIndex)) {
-                    auto runLength = std::min(palIndex & ~RLE_CODE, entry.Width - x);
-                    palIndex = buffer[offset++];
-                    Palette::Color color = palette.Data[palIndex];
-                    Palette::CheckTransparency(color, palIndex);
-
-                    for (int j = 0; j < runLength; j++, x++, h++) {
-                        bmp.Data[h] = color;
-                        bmp.Indexed[h] = palIndex;
-                    }
+    namespace {
+        // Palette lookup tables with the transparency rules already applied
+        struct ColorTable {
+            Array<Palette::Color, 256> Colors;
+            Array<Palette::Color, 256> MaskedColors; // Supertransparent index is cleared and moved to the mask
+            Array<Palette::Color, 256> Mask; // Mask values for supertransparent bitmaps
+
+            explicit ColorTable(const Palette& palette) {
+                for (int i = 0; i < 256; i++) {
+                    auto color = palette.Data[i];
+                    Palette::CheckTransparency(color, (ubyte)i);
+                    Colors[i] = MaskedColors[i] = color;
+                    Mask[i] = { 0, 0, 0, 255 };
                 }
-                else {
-                    bmp.Data[h] = palette.Data[palIndex];
-                    bmp.Indexed[h] = palIndex;
-                    Palette::CheckTransparency(bmp.Data[h], palIndex);
-                    x++, h++;
+
+                MaskedColors[Palette::ST_INDEX] = { 0, 0, 0, 0 };
+                Mask[Palette::ST_INDEX] = { 255, 255, 255, 255 };
+            }
+        };
+
+        // Writes palette indices into the color, index and mask buffers of a bitmap in one pass
+        class BitmapWriter {
+            PigBitmap& _bmp;
+            const Palette::Color* _colors;
+            const Palette::Color* _mask = nullptr;
+
+        public:
+            BitmapWriter(PigBitmap& bmp, const ColorTable& table) : _bmp(bmp), _colors(table.Colors.data()) {
+                auto size = (size_t)bmp.Info.Width * bmp.Info.Height;
+                bmp.Data.resize(size);
+                bmp.Indexed.resize(size);
+
+                if (bmp.Info.SuperTransparent) {
+                    bmp.Mask.resize(size);
+                    _colors = table.MaskedColors.data();
+                    _mask = table.Mask.data();
                 }
             }
-        }
 
-        return bmp;
-    }
+            // Expands a run of a single index
+            void Fill(size_t offset, ubyte index, size_t count) {
+                std::fill_n(&_bmp.Data[offset], count, _colors[index]);
+                memset(&_bmp.Indexed[offset], index, count);
+                if (_mask) std::fill_n(&_bmp.Mask[offset], count, _mask[index]);
+            }
+
+            // Copies literal indices
+            void Copy(size_t offset, const ubyte* indices, size_t count) {
+                memcpy(&_bmp.Indexed[offset], indices, count);
+                Resolve(offset, count);
+            }
+
+            // Resolves colors for indices already stored in the bitmap
+            void Resolve(size_t offset, size_t count) {
+                auto indices = &_bmp.Indexed[offset];
+                auto data = &_bmp.Data[offset];
+                for (size_t i = 0; i < count; i++)
+                    data[i] = _colors[indices[i]];
+
+                if (_mask) {
+                    auto mask = &_bmp.Mask[offset];
+                    for (size_t i = 0; i < count; i++)
+                        mask[i] = _mask[indices[i]];
+                }
+            }
+        };
+
+        // Rows are stored top to bottom, which is the final texture layout
+        PigBitmap ReadRLE(StreamReader& reader,
+                          size_t dataStart,
+                          const ColorTable& table,
+                          const PigEntry& entry) {
+            PigBitmap bmp(entry);
+            BitmapWriter writer(bmp, table);
+            reader.Seek(dataStart + entry.DataOffset);
+            /*auto size = */
+            reader.ReadInt32();
+
+            List<uint16> rowSize(entry.Height);
+            List<uint8> buffer(entry.Width * 3);
+
+            if (entry.UsesBigRle) {
+                // long scan lines (>= 256 bytes), row lengths are stored as shorts
+                reader.ReadBytes(rowSize.data(), entry.Height * sizeof(int16));
+            }
+            else {
+                // row lengths are stored as bytes
+                List<ubyte> sizes(entry.Height);
+                reader.ReadBytes(sizes);
+                std::copy(sizes.begin(), sizes.end(), rowSize.begin());
+            }
 
-    PigBitmap ReadBMP(StreamReader& reader,
-                      size_t dataStart,
-                      const Palette& palette,
-                      const PigEntry& entry) {
-        reader.Seek(dataStart + entry.DataOffset);
-
-        PigBitmap bmp(entry);
-        bmp.Data.resize((size_t)entry.Width * entry.Height);
-        bmp.Indexed.resize((size_t)entry.Width * entry.Height);
-
-        for (int y = entry.Height - 1; y >= 0; y--) {
-            int h = y * entry.Width;
-            for (int x = 0; x < entry.Width; x++, h++) {
-                auto palIndex = reader.ReadByte();
-                bmp.Indexed[h] = palIndex;
-                bmp.Data[h] = palette.Data[palIndex];
-                Palette::CheckTransparency(bmp.Data[h], palIndex);
+            for (int row = 0; row < entry.Height; row++) {
+                auto rowLength = rowSize[row];
+                if (rowLength > buffer.size()) buffer.resize(rowLength);
+                reader.ReadBytes(buffer.data(), rowLength);
+
+                size_t h = (size_t)row * entry.Width;
+                for (int x = 0, offset = 0; x < entry.Width && offset < rowLength;) {
+                    auto palIndex = buffer[offset];
+
+                    if (IsRleCode(palIndex)) {
+                        if (offset + 1 >= rowLength) break;
+                        auto runLength = std::min(palIndex & ~RLE_CODE, entry.Width - x);
+                        writer.Fill(h, buffer[offset + 1], runLength);
+                        offset += 2;
+                        x += runLength;
+                        h += runLength;
+                    }
+                    else {
+                        // Gather the literal span up to the next run
+                        int end = offset + 1;
+                        while (end < rowLength && end - offset < entry.Width - x && !IsRleCode(buffer[end]))
+                            end++;
+
+                        auto count = end - offset;
+                        writer.Copy(h, &buffer[offset], count);
+                        offset = end;
+                        x += count;
+                        h += count;
+                    }
+                }
             }
+
+            return bmp;
         }
 
-        return bmp;
+        PigBitmap ReadBMP(StreamReader& reader,
+                          size_t dataStart,
+                          const ColorTable& table,
+                          const PigEntry& entry) {
+            reader.Seek(dataStart + entry.DataOffset);
+
+            PigBitmap bmp(entry);
+            BitmapWriter writer(bmp, table);
+            reader.ReadBytes(bmp.Indexed);
+            writer.Resolve(0, bmp.Indexed.size());
+            return bmp;
+        }
+
+        PigBitmap ReadBitmapEntry(StreamReader& reader,
+                                  size_t dataStart,
+                                  const PigEntry& entry,
+                                  const ColorTable& table) {
+            return entry.UsesRle ?
+                ReadRLE(reader, dataStart, table, entry) :
+                ReadBMP(reader, dataStart, table, entry);
+        }
     }
 
     PigBitmap ReadBitmapEntry(StreamReader& reader,
                               size_t dataStart,
                               const PigEntry& entry,
                               const Palette& palette) {
-        auto bmp = entry.UsesRle ?
-            ReadRLE(reader, dataStart, palette, entry) :
-            ReadBMP(reader, dataStart, palette, entry);
+        return ReadBitmapEntry(reader, dataStart, entry, ColorTable(palette));
+    }
 
-        FlipBitmapY(bmp);
-        if (entry.SuperTransparent)
-            bmp.ExtractMask();
+    void ResolveBitmapColors(PigBitmap& bmp, const Palette& palette) {
+        if (bmp.Indexed.size() != (size_t)bmp.Info.Width * bmp.Info.Height)
+            throw Exception("Bitmap indexed data does not match its size");
 
-        return bmp;
+        ColorTable table(palette);
+        BitmapWriter writer(bmp, table);
+        writer.Resolve(0, bmp.Indexed.size());
     }
 
     PigBitmap ReadBitmap(const PigFile& pig, const Palette& palette, TexID id) {
@@ -302,16 +363,150 @@ namespace Inferno {
         return ReadBitmapEntry(reader, pig.DataStart, entry, palette);
     }
 
-    List<PigBitmap> ReadAllBitmaps(const PigFile& pig, const Palette& palette) {
-        List<PigBitmap> bitmaps;
+    List<PigBitmap> ReadBitmaps(span<const ubyte> data, size_t dataStart, span<const PigEntry> entries,
+                                const Palette& palette, const BitmapProgressCallback& progress) {
+        List<PigBitmap> bitmaps(entries.size());
+        const ColorTable table(palette);
+        std::atomic<size_t> done = 0;
 
-        StreamReader reader(pig.Path);
-        for (auto& entry : pig.Entries)
-            bitmaps.push_back(ReadBitmapEntry(reader, pig.DataStart, entry, palette));
+        // Each batch writes to its own slots, so the order is deterministic
+        ParallelFor(entries.size(), 32, [&](size_t begin, size_t end) {
+            StreamReader reader(data);
+            for (auto i = begin; i < end; i++)
+                bitmaps[i] = ReadBitmapEntry(reader, dataStart, entries[i], table);
+
+            auto count = done += end - begin;
+            if (progress) progress(count, entries.size());
+        });
 
         return bitmaps;
     }
 
+    List<PigBitmap> ReadAllBitmaps(const PigFile& pig, const Palette& palette, const BitmapProgressCallback& progress) {
+        // Read the whole data region at once, entry offsets are relative to it
+        std::ifstream file(pig.Path, std::ios::binary);
+        if (!file) throw Exception("Unable to open PIG file");
+
+        auto size = filesystem::file_size(pig.Path);
+        if (size < pig.DataStart) throw Exception("PIG file is missing data");
+
+        List<ubyte> data(size - pig.DataStart);
+        file.seekg(pig.DataStart);
+        file.read((char*)data.data(), data.size());
+
+        return ReadBitmaps(data, 0, pig.Entries, palette, progress);
+    }
+
+    PaletteLookup::PaletteLookup(const Palette& palette) {
+        _colors = (int)std::min(palette.Data.size(), _r.size());
+
+        for (int i = 0; i < _colors; i++) {
+            _r[i] = palette.Data[i].r;
+            _g[i] = palette.Data[i].g;
+            _b[i] = palette.Data[i].b;
+        }
+    }
+
+    PaletteLookup::Grid PaletteLookup::BuildGrid(int colors) const {
+        constexpr int CELL_SIZE = 1 << CELL_BITS;
+        Grid grid;
+        grid.Start.reserve(GRID_SIZE * GRID_SIZE * GRID_SIZE + 1);
+
+        // Squared distance from a value to the nearest and farthest point of a cell along one axis
+        auto axisRange = [](int value, int low, int& nearest, int& farthest) {
+            int high = low + CELL_SIZE - 1;
+            int below = low - value, above = value - high;
+            int n = std::max({ below, above, 0 });
+            int f = std::max(std::abs(value - low), std::abs(value - high));
+            nearest = n * n;
+            farthest = f * f;
+        };
+
+        Array<int, 256> nearest{};
+
+        for (int r = 0; r < 256; r += CELL_SIZE) {
+            for (int g = 0; g < 256; g += CELL_SIZE) {
+                for (int b = 0; b < 256; b += CELL_SIZE) {
+                    // A color can only be nearest to a point in the cell if its nearest distance
+                    // is within the smallest farthest distance of any color
+                    int bound = INT_MAX;
+
+                    for (int i = 0; i < colors; i++) {
+                        int nr, fr, ng, fg, nb, fb;
+                        axisRange(_r[i], r, nr, fr);
+                        axisRange(_g[i], g, ng, fg);
+                        axisRange(_b[i], b, nb, fb);
+                        nearest[i] = nr + ng + nb;
+                        bound = std::min(bound, fr + fg + fb);
+                    }
+
+                    grid.Start.push_back((uint32)grid.Candidates.size());
+
+                    for (int i = 0; i < colors; i++) {
+                        if (nearest[i] <= bound)
+                            grid.Candidates.push_back((ubyte)i);
+                    }
+                }
+            }
+        }
+
+        grid.Start.push_back((uint32)grid.Candidates.size());
+        return grid;
+    }
+
+    const PaletteLookup::Grid& PaletteLookup::GetGrid(bool transparent) {
+        auto& grid = transparent ? _transparent : _opaque;
+        if (grid.Start.empty())
+            grid = BuildGrid(transparent ? _colors : std::min(_colors, (int)Palette::ST_INDEX));
+
+        return grid;
+    }
+
+    ubyte PaletteLookup::GetClosestIndex(const Palette::Color& color, bool transparent) {
+        auto& grid = GetGrid(transparent);
+        auto cell = ((color.r >> CELL_BITS) * GRID_SIZE + (color.g >> CELL_BITS)) * GRID_SIZE + (color.b >> CELL_BITS);
+        auto begin = grid.Start[cell], end = grid.Start[cell + 1];
+
+        int closestDelta = INT_MAX;
+        ubyte closestIndex = 0;
+
+        for (auto c = begin; c < end; c++) {
+            auto i = grid.Candidates[c];
+            int dr = _r[i] - color.r, dg = _g[i] - color.g, db = _b[i] - color.b;
+            int delta = dr * dr + dg * dg + db * db;
+
+            // Candidates are in palette order so ties resolve to the lowest index
+            if (delta < closestDelta) {
+                closestIndex = i;
+                if (delta == 0) break;
+                closestDelta = delta;
+            }
+        }
+
+        return closestIndex;
+    }
+
+    void PaletteLookup::QuantizeImage(span<const Palette::Color> colors, span<ubyte> dest, bool transparent) {
+        if (dest.size() != colors.size())
+            throw Exception("Quantize destination does not match the image size");
+
+        GetGrid(transparent);
+        Option<Palette::Color> previous;
+        ubyte previousIndex = 0;
+
+        for (size_t i = 0; i < colors.size(); i++) {
+            auto& color = colors[i];
+
+            // Images tend to have runs of the same color
+            if (!previous || previous->r != color.r || previous->g != color.g || previous->b != color.b) {
+                previousIndex = GetClosestIndex(color, transparent);
+                previous = color;
+            }
+
+            dest[i] = previousIndex;
+        }
+    }
+
     Palette ReadPalette(span<ubyte> data) {
         // It does not read the fade table from the file.
         Palette palette;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include "Types.h"
 #include "Streams.h"
 
@@ -29,33 +30,38 @@ namespace Inferno {
         Palette() : FadeTables(34 * 256), Data(256) {}
     };
 
-    // Helper that finds the nearest palette index for a color. Uses caching.
+    // Finds the nearest palette index for colors.
+    // The RGB cube is split into a coarse grid where each cell lists the palette entries that can be nearest
+    // to a color inside of it, so a lookup only compares a few candidates. Results match a full linear search.
+    // Transparent lookups include the two transparent indices and use a separate grid.
     class PaletteLookup {
-        const Palette& _palette;
-        Dictionary<uint32, ubyte> _cache; // maps color to index
+        static constexpr int CELL_BITS = 4;
+        static constexpr int GRID_SIZE = 256 >> CELL_BITS; // Cells per axis
+
+        struct Grid {
+            List<uint32> Start; // Offset of each cell in Candidates, with one extra entry for the end
+            List<ubyte> Candidates; // Palette indices in ascending order for each cell
+        };
+
+        Array<int, 256> _r{}, _g{}, _b{}; // Palette channels
+        int _colors = 0;
+        Grid _opaque, _transparent; // Built on first use
+
+        const Grid& GetGrid(bool transparent);
+        Grid BuildGrid(int colors) const;
+
     public:
-        PaletteLookup(const Palette& palette) : _palette(palette) {}
-
-        ubyte GetClosestIndex(const Palette::Color& color, bool transparent) {
-            uint hash = (int)color.r + ((int)color.g << 8) + ((int)color.b << 16);
-            if (_cache.contains(hash))
-                return _cache[hash];
-
-            uint closestDelta = 0x7fffffff;
-            ubyte closestIndex = 0;
-
-            for (int i = 0; i < (transparent ? 256 : 254); i++) {
-                uint delta = color.Delta(_palette.Data[i]);
-                if (delta < closestDelta) {
-                    closestIndex = (ubyte)i;
-                    if (delta == 0)
-                        break;
-                    closestDelta = delta;
-                }
-            }
+        PaletteLookup(const Palette& palette);
 
-            _cache[hash] = closestIndex;
-            return closestIndex;
+        ubyte GetClosestIndex(const Palette::Color& color, bool transparent);
+
+        // Converts colors to their nearest palette index. Dest must be the same size as colors.
+        void QuantizeImage(span<const Palette::Color> colors, span<ubyte> dest, bool transparent);
+
+        List<ubyte> QuantizeImage(span<const Palette::Color> colors, bool transparent) {
+            List<ubyte> indices(colors.size());
+            QuantizeImage(colors, indices, transparent);
+            return indices;
         }
     };
 
@@ -198,9 +204,21 @@ namespace Inferno {
     };
 
 
+    // Called with the number of decoded bitmaps and the total. Can be called from multiple threads at once.
+    using BitmapProgressCallback = std::function<void(size_t done, size_t total)>;
+
     PigBitmap ReadBitmap(const PigFile& pig, const Palette& palette, TexID id);
     PigBitmap ReadBitmapEntry(StreamReader&, size_t dataStart, const PigEntry&, const Palette&);
-    List<PigBitmap> ReadAllBitmaps(const PigFile& pig, const Palette& palette);
+
+    // Resolves the color data and supertransparent mask of a bitmap from its indexed data
+    void ResolveBitmapColors(PigBitmap& bmp, const Palette& palette);
+
+    // Decodes bitmaps from a buffer in parallel. Results are in the same order as the entries.
+    List<PigBitmap> ReadBitmaps(span<const ubyte> data, size_t dataStart, span<const PigEntry> entries,
+                                const Palette& palette, const BitmapProgressCallback& progress = {});
+
+    // Reads the PIG data region once and decodes every entry in parallel
+    List<PigBitmap> ReadAllBitmaps(const PigFile& pig, const Palette& palette, const BitmapProgressCallback& progress = {});
 
     //Dictionary<TexID, PigBitmap> ReadDTX(span<PigEntry> pigEntries, span<ubyte> data, const Palette& palette);
     //Dictionary<TexID, PigBitmap> ReadPoggies(span<PigEntry> pigEntries, span<ubyte> data, const Palette& palette);
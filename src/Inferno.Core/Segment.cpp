@@ -2,6 +2,7 @@
 #include "Segment.h"
 #include "Level.h"
 #include "Face.h"
+#include <atomic>
 
 namespace Inferno {
     bool Segment::SideIsSolid(SideID side, Level& level) const {
@@ -22,7 +23,12 @@ namespace Inferno {
         return normal;
     }
 
+    namespace {
+        std::atomic<uint32> GeometryVersions = 0;
+    }
+
     void Segment::UpdateGeometricProps(const Level& level) {
+        GeometryVersion = ++GeometryVersions; // Unique, so caches notice segments that moved to another index
         for (auto& s : SideIDs) {
             auto& side = GetSide(s);
             auto& sideVerts = SIDE_INDICES[(int)s];
@@ -139,6 +139,8 @@ namespace Inferno {
         Color VolumeLight = { 1, 1, 1 };
         bool LockVolumeLight; // Locks volume light from being updated
         Vector3 Center;
+        List<ObjID> Objects; // Live objects in this segment. Maintained by the level, not saved.
+        uint32 GeometryVersion{}; // Changes every time the geometric props are updated. Not saved.
 
         constexpr SegID GetConnection(SideID side) const { return Connections[(int)side]; }
         SegID& GetConnection(SideID side) { return Connections[(int)side]; }
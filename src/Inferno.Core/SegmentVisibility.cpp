@@ -0,0 +1,276 @@
+#include "pch.h"
+#include "SegmentVisibility.h"
+#include "Parallel.h"
+#include "TextureCache.h"
+
+namespace Inferno {
+    namespace {
+        constexpr float PORTAL_TOLERANCE = 0.1f;
+
+        struct Portal {
+            Array<Vector3, 4> Points;
+            Vector3 Center;
+            Vector3 Direction; // Direction of travel through the portal, out of the segment
+            float Flatness = 0; // Furthest distance of a point from the portal plane
+            int Next = -1; // Segment on the other side. Negative when closed.
+            int NextSide = 0; // Side of the next segment that leads back
+        };
+
+        // Returns true if any point of the portal is in front of the plane of another
+        bool InFront(const Portal& portal, const Portal& plane) {
+            for (auto& point : portal.Points) {
+                if ((point - plane.Center).Dot(plane.Direction) > -(plane.Flatness + PORTAL_TOLERANCE))
+                    return true;
+            }
+
+            return false;
+        }
+
+        // Returns true if any point of the portal is behind the plane of another
+        bool Behind(const Portal& portal, const Portal& plane) {
+            for (auto& point : portal.Points) {
+                if ((point - plane.Center).Dot(plane.Direction) < plane.Flatness + PORTAL_TOLERANCE)
+                    return true;
+            }
+
+            return false;
+        }
+
+        List<Portal> CreatePortals(const Level& level, const SegmentVisibility::SideFilter& isOpen) {
+            List<Portal> portals(level.Segments.size() * 6);
+
+            ParallelFor(level.Segments.size(), 256, [&](size_t begin, size_t end) {
+                for (size_t segIndex = begin; segIndex < end; segIndex++) {
+                    auto& seg = level.Segments[segIndex];
+
+                    for (auto& sideId : SideIDs) {
+                        auto& portal = portals[segIndex * 6 + (int)sideId];
+                        auto indices = seg.GetVertexIndices(sideId);
+                        for (int i = 0; i < 4; i++)
+                            portal.Points[i] = level.Vertices[indices[i]];
+
+                        auto& p = portal.Points;
+                        portal.Center = (p[0] + p[1] + p[2] + p[3]) / 4;
+                        portal.Direction = (p[2] - p[0]).Cross(p[3] - p[1]);
+                        portal.Direction.Normalize();
+
+                        // Point out of the segment regardless of winding
+                        if ((seg.Center - portal.Center).Dot(portal.Direction) > 0)
+                            portal.Direction = -portal.Direction;
+
+                        for (auto& point : p)
+                            portal.Flatness = std::max(portal.Flatness, std::abs((point - portal.Center).Dot(portal.Direction)));
+
+                        auto connection = seg.GetConnection(sideId);
+                        if (connection <= SegID::None || (size_t)connection >= level.Segments.size()) continue;
+                        if (isOpen && !isOpen(level, seg, sideId)) continue;
+
+                        auto& next = level.Segments[(int)connection];
+                        for (auto& nextSide : SideIDs) {
+                            if (next.GetConnection(nextSide) == SegID(segIndex)) {
+                                portal.Next = (int)connection;
+                                portal.NextSide = (int)nextSide;
+                                break;
+                            }
+                        }
+                    }
+                }
+            });
+
+            return portals;
+        }
+
+        // Floods out of a segment through every portal, tracking the first portal of each chain
+        void FlowFrom(int source, span<const Portal> portals, List<ubyte>& visible, List<uint32>& visited, uint32& epoch) {
+            struct State {
+                int Segment;
+                int Entry; // Portal used to enter the segment
+            };
+
+            List<State> stack;
+            visible[source] = true;
+
+            for (int firstSide = 0; firstSide < 6; firstSide++) {
+                auto firstIndex = source * 6 + firstSide;
+                auto& first = portals[firstIndex];
+                if (first.Next < 0) continue;
+
+                visible[first.Next] = true;
+                epoch++;
+                visited[first.Next * 6 + first.NextSide] = epoch;
+                stack.push_back({ first.Next, firstIndex });
+
+                while (!stack.empty()) {
+                    auto state = stack.back();
+                    stack.pop_back();
+
+                    auto& entry = portals[state.Entry];
+
+                    for (int side = 0; side < 6; side++) {
+                        if (side == entry.NextSide) continue; // Don't go back through the entry
+
+                        auto index = state.Segment * 6 + side;
+                        auto& portal = portals[index];
+                        if (portal.Next < 0) continue;
+
+                        // A line of sight crosses each portal plane in order, so it can't turn back through a later one
+                        if (!InFront(portal, first) || !InFront(portal, entry) || !Behind(first, portal))
+                            continue;
+
+                        visible[portal.Next] = true;
+
+                        auto& mark = visited[portal.Next * 6 + portal.NextSide];
+                        if (mark == epoch) continue;
+                        mark = epoch;
+                        stack.push_back({ portal.Next, index });
+                    }
+                }
+            }
+        }
+
+        // Encodes a bitset with runs of zero bytes replaced by a zero and the run length
+        List<ubyte> Compress(span<const ubyte> visible) {
+            List<ubyte> row;
+            auto count = visible.size();
+
+            for (size_t byteIndex = 0; byteIndex * 8 < count; byteIndex++) {
+                ubyte value = 0;
+                for (size_t bit = 0; bit < 8 && byteIndex * 8 + bit < count; bit++) {
+                    if (visible[byteIndex * 8 + bit])
+                        value |= 1 << bit;
+                }
+
+                if (value == 0 && row.size() >= 2 && row[row.size() - 2] == 0 && row.back() < 255) {
+                    row.back()++;
+                }
+                else if (value == 0) {
+                    row.push_back(0);
+                    row.push_back(1);
+                }
+                else {
+                    row.push_back(value);
+                }
+            }
+
+            return row;
+        }
+
+        uint64 HashSegment(const Level& level, const Segment& seg, const SegmentVisibility::SideFilter& isOpen) {
+            uint64 hash = HashBytes({});
+            auto add = [&hash](const auto& value) {
+                hash = HashBytes({ (const ubyte*)&value, sizeof(value) }, hash);
+            };
+
+            for (auto index : seg.Indices)
+                add(level.Vertices[index]);
+
+            add(seg.Connections);
+
+            for (auto& sideId : SideIDs)
+                add(isOpen ? isOpen(level, seg, sideId) : true);
+
+            return hash;
+        }
+    }
+
+    void SegmentVisibility::BuildRows(const Level& level, span<const int> segments) {
+        auto portals = CreatePortals(level, _isOpen);
+        auto segmentCount = level.Segments.size();
+
+        ParallelFor(segments.size(), 16, [&](size_t begin, size_t end) {
+            List<ubyte> visible(segmentCount);
+            List<uint32> visited(segmentCount * 6);
+            uint32 epoch = 0;
+
+            for (size_t i = begin; i < end; i++) {
+                std::fill(visible.begin(), visible.end(), ubyte(0));
+                FlowFrom(segments[i], portals, visible, visited, epoch);
+                _rows[segments[i]] = Compress(visible);
+            }
+        });
+    }
+
+    void SegmentVisibility::Update(const Level& level) {
+        auto segmentCount = level.Segments.size();
+        List<uint64> hashes(segmentCount);
+
+        ParallelFor(segmentCount, 256, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                hashes[i] = HashSegment(level, level.Segments[i], _isOpen);
+        });
+
+        List<int> rebuild;
+
+        if (_rows.size() != segmentCount) {
+            _rows.assign(segmentCount, {});
+            for (int i = 0; i < segmentCount; i++)
+                rebuild.push_back(i);
+        }
+        else {
+            List<SegID> changed;
+            for (int i = 0; i < segmentCount; i++) {
+                if (hashes[i] != _hashes[i])
+                    changed.push_back(SegID(i));
+            }
+
+            if (changed.empty()) return;
+
+            // A segment can only start or stop seeing past a changed segment if it could see the changed segment before,
+            // since every portal on the way to the new area belongs to a segment it could already see.
+            List<ubyte> bits;
+            for (int i = 0; i < segmentCount; i++) {
+                GetVisible(SegID(i), bits);
+                if (Seq::exists(changed, [&bits](SegID id) { return Contains(bits, id); }))
+                    rebuild.push_back(i);
+            }
+        }
+
+        BuildRows(level, rebuild);
+        _hashes = std::move(hashes);
+    }
+
+    bool SegmentVisibility::CanSee(SegID from, SegID to) const {
+        if (!Seq::inRange(_rows, (int)from) || !Seq::inRange(_rows, (int)to)) return false;
+
+        auto target = (size_t)to / 8;
+        size_t byteIndex = 0;
+        auto& row = _rows[(int)from];
+
+        for (size_t i = 0; i < row.size() && byteIndex <= target; i++) {
+            if (row[i] == 0) {
+                byteIndex += row[++i]; // Run of empty bytes
+                continue;
+            }
+
+            if (byteIndex == target)
+                return row[i] & (1 << ((size_t)to % 8));
+
+            byteIndex++;
+        }
+
+        return false;
+    }
+
+    void SegmentVisibility::GetVisible(SegID from, List<ubyte>& bits) const {
+        bits.assign((_rows.size() + 7) / 8, 0);
+        if (!Seq::inRange(_rows, (int)from)) return;
+
+        size_t byteIndex = 0;
+        auto& row = _rows[(int)from];
+
+        for (size_t i = 0; i < row.size(); i++) {
+            if (row[i] == 0)
+                byteIndex += row[++i];
+            else
+                bits[byteIndex++] = row[i];
+        }
+    }
+
+    size_t SegmentVisibility::CompressedSize() const {
+        size_t size = 0;
+        for (auto& row : _rows)
+            size += row.size();
+
+        return size;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <functional>
+#include "Level.h"
+
+namespace Inferno {
+    // Potentially visible set of segments. A segment can see another if a chain of open sides
+    // connects them and no portal in the chain is completely behind the first portal or the one before it.
+    // The result is conservative: segments that are actually visible are never excluded.
+    //
+    // Each row is a bitset with one bit per segment. Runs of zero bytes are stored as a zero followed by the run length,
+    // since most segments only see a small part of the level.
+    class SegmentVisibility {
+    public:
+        // Returns true if sight passes through a connected side
+        using SideFilter = std::function<bool(const Level&, const Segment&, SideID)>;
+
+    private:
+        SideFilter _isOpen;
+        List<List<ubyte>> _rows; // Compressed, indexed by segment
+        List<uint64> _hashes; // Geometry of each segment when its row was built
+
+        void BuildRows(const Level& level, span<const int> segments);
+
+    public:
+        // Every connected side is open when no filter is given
+        SegmentVisibility(SideFilter isOpen = {}) : _isOpen(std::move(isOpen)) {}
+
+        // Rebuilds the rows affected by segments that changed since the last update.
+        // Rebuilds everything if the segment count changed.
+        void Update(const Level& level);
+
+        void Clear() {
+            _rows.clear();
+            _hashes.clear();
+        }
+
+        // Returns true if anything in a segment might be visible from anywhere in another
+        bool CanSee(SegID from, SegID to) const;
+
+        // Decompresses the segments visible from a segment into one bit per segment
+        void GetVisible(SegID from, List<ubyte>& bits) const;
+
+        static bool Contains(span<const ubyte> bits, SegID id) {
+            auto index = (size_t)id;
+            return index / 8 < bits.size() && bits[index / 8] & (1 << (index % 8));
+        }
+
+        size_t SegmentCount() const { return _rows.size(); }
+
+        // Bytes used by the compressed rows
+        size_t CompressedSize() const;
+    };
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Level.h"
+#include "Utility.h"
+
+namespace Inferno {
+    // Walks connected segments without recursion. Visited segments are marked with the epoch of the walk,
+    // so starting a new walk doesn't need to clear the marks and nothing is allocated once the buffers have grown.
+    // Sweeps walk segments in the order the swept shape reaches them instead of depth first.
+    class SegmentWalk {
+        struct Entry {
+            float Time; // When the sweep reaches the segment
+            SegID Segment;
+
+            // Orders the heap by earliest time. Ties use the segment so the order doesn't depend on the heap.
+            bool operator<(const Entry& other) const {
+                return Time > other.Time || (Time == other.Time && Segment > other.Segment);
+            }
+        };
+
+        List<uint32> _visited; // Epoch of the walk that last visited each segment
+        List<SegID> _stack;
+        List<Entry> _queue; // Heap of segments reached by a sweep
+        uint32 _epoch = 0;
+
+        void NextEpoch(const Level& level) {
+            if (_visited.size() != level.Segments.size()) {
+                _visited.assign(level.Segments.size(), 0);
+                _epoch = 0;
+            }
+
+            if (++_epoch == 0) {
+                // Wrapped around, old marks could match again
+                std::ranges::fill(_visited, 0);
+                _epoch = 1;
+            }
+        }
+
+    public:
+        void Begin(const Level& level, SegID start) {
+            NextEpoch(level);
+            _stack.clear();
+            Push(start);
+        }
+
+        // Queues a segment if this walk hasn't visited it yet
+        void Push(SegID id) {
+            if (!Seq::inRange(_visited, (int)id)) return;
+            auto& mark = _visited[(int)id];
+            if (mark == _epoch) return;
+            mark = _epoch;
+            _stack.push_back(id);
+        }
+
+        bool Pop(SegID& id) {
+            if (_stack.empty()) return false;
+            id = _stack.back();
+            _stack.pop_back();
+            return true;
+        }
+
+        // Starts a walk that pops segments in the order a sweep reaches them
+        void BeginSweep(const Level& level, SegID start) {
+            NextEpoch(level);
+            _queue.clear();
+            Push(start, 0);
+        }
+
+        // Queues a segment reached by a sweep. A segment can be queued through several portals, but is only popped once at its earliest time.
+        void Push(SegID id, float time) {
+            if (!Seq::inRange(_visited, (int)id) || _visited[(int)id] == _epoch) return;
+            _queue.push_back({ time, id });
+            std::push_heap(_queue.begin(), _queue.end());
+        }
+
+        bool PopNearest(SegID& id, float& time) {
+            while (!_queue.empty()) {
+                std::pop_heap(_queue.begin(), _queue.end());
+                auto entry = _queue.back();
+                _queue.pop_back();
+
+                auto& mark = _visited[(int)entry.Segment];
+                if (mark == _epoch) continue; // already reached sooner
+                mark = _epoch;
+
+                id = entry.Segment;
+                time = entry.Time;
+                return true;
+            }
+
+            return false;
+        }
+    };
+}
@@ -39,31 +39,61 @@ namespace Inferno {
     };
 
     // Encapsulates reading binary fixed point data from a stream.
+    // Readers created from memory read directly from the buffer with bounds checked pointer bumps
+    // instead of going through std::istream.
     class StreamReader {
-        std::unique_ptr<std::istream> _stream;
+        std::unique_ptr<std::istream> _stream; // Stream backend. Null when reading from memory.
         std::filesystem::path _file;
         List<ubyte> _data;
 
+        // Memory backend
+        const ubyte* _begin = nullptr;
+        const ubyte* _ptr = nullptr;
+        const ubyte* _end = nullptr;
+
+        void SetBuffer(span<const ubyte> data) {
+            _begin = _ptr = data.data();
+            _end = _begin + data.size();
+        }
+
+        // Bytes left in the buffer
+        size_t Remaining() const { return _ptr < _end ? size_t(_end - _ptr) : 0; }
+
+        // Returns the current pointer and advances the memory backend. Throws if the read is out of bounds.
+        const ubyte* Take(size_t length) {
+            if (_ptr > _end || length > size_t(_end - _ptr))
+                throw Exception(fmt::format("Read past end of stream {}", _file.string()));
+
+            auto p = _ptr;
+            _ptr += length;
+            return p;
+        }
+
         template<class T>
         T Read() {
             T b{};
-            _stream->read((char*)&b, sizeof(T));
+            if (_stream)
+                _stream->read((char*)&b, sizeof(T));
+            else
+                memcpy(&b, Take(sizeof(T)), sizeof(T));
+
             return b;
         }
     public:
-        StreamReader(span<ubyte> data, const string& name = "") {
-            _stream = std::make_unique<MemoryStream>((char*)data.data(), data.size());
+        StreamReader(span<const ubyte> data, const string& name = "") {
+            SetBuffer(data);
             _file = name;
         }
 
         // Takes ownership of data
         StreamReader(List<ubyte>&& data, const string& name = "") {
             _data = std::move(data);
-            _stream = std::make_unique<MemoryStream>((char*)_data.data(), _data.size());
+            SetBuffer(_data);
             _file = name;
         }
 
-        StreamReader(std::unique_ptr<std::ifstream> stream) {
+        // Reads through a stream, such as a file or a MemoryStream
+        StreamReader(std::unique_ptr<std::istream> stream) {
             _stream = std::move(stream);
         }
 
@@ -76,42 +106,76 @@ namespace Inferno {
         StreamReader(const StreamReader&) = delete;
         StreamReader& operator=(const StreamReader&) = delete;
 
+        // Moving the owned vector keeps its buffer, so the memory pointers remain valid
         StreamReader(StreamReader&& other) noexcept {
             _data = std::move(other._data);
             _stream = std::move(other._stream);
             _file.swap(other._file);
+            _begin = std::exchange(other._begin, nullptr);
+            _ptr = std::exchange(other._ptr, nullptr);
+            _end = std::exchange(other._end, nullptr);
         }
 
         StreamReader& operator=(StreamReader&& other) noexcept {
             _data = std::move(other._data);
             _stream = std::move(other._stream);
             _file.swap(other._file);
+            _begin = std::exchange(other._begin, nullptr);
+            _ptr = std::exchange(other._ptr, nullptr);
+            _end = std::exchange(other._end, nullptr);
+            return *this;
         }
 
         ~StreamReader() = default;
 
+        // Returns true when reading from memory instead of a file
+        bool IsMemory() const { return !_stream; }
+
         List<sbyte> ReadSBytes(size_t length) {
             List<sbyte> b(length);
-            _stream->read(b.data(), sizeof(sbyte) * length);
+            ReadBytes(b.data(), sizeof(sbyte) * length);
             return b;
         }
 
         List<ubyte> ReadUBytes(size_t length) {
             List<ubyte> b(length);
-            _stream->read((char*)b.data(), sizeof(ubyte) * length);
+            ReadBytes(b.data(), sizeof(ubyte) * length);
             return b;
         }
 
         void ReadBytes(void* buffer, size_t length) {
-            _stream->read((char*)buffer, length);
+            if (_stream)
+                _stream->read((char*)buffer, length);
+            else if (length > 0)
+                memcpy(buffer, Take(length), length);
         }
 
         void ReadBytes(span<ubyte> buffer) {
-            _stream->read((char*)buffer.data(), buffer.size());
+            ReadBytes(buffer.data(), buffer.size());
+        }
+
+        // Reads an array of trivially copyable elements in a single copy
+        template<class T>
+        void ReadArray(span<T> dest) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            ReadBytes(dest.data(), dest.size_bytes());
+        }
+
+        template<class T>
+        List<T> ReadArray(size_t count) {
+            List<T> items(count);
+            ReadArray<T>(items);
+            return items;
         }
 
         // Reads a fixed length string
         string ReadString(size_t length) {
+            if (!_stream) {
+                // Stop at the first null like the buffered version
+                auto p = (const char*)Take(length);
+                return { p, strnlen(p, length) };
+            }
+
             List<char> b(length + 1);
             _stream->read(b.data(), sizeof(char) * length);
             return { b.data() };
@@ -119,6 +183,14 @@ namespace Inferno {
 
         // Reads a null terminated string up to the max length
         string ReadCString(size_t maxLen) {
+            if (!_stream) {
+                auto available = std::min(maxLen, Remaining());
+                auto p = (const char*)_ptr;
+                auto len = strnlen(p, available);
+                _ptr += len < available ? len + 1 : len; // consume the terminator
+                return { p, len };
+            }
+
             List<char> b(maxLen + 1);
             for (int i = 0; i < maxLen; i++) {
                 _stream->read(&b[i], sizeof(char));
@@ -129,6 +201,15 @@ namespace Inferno {
 
         // Reads a newline terminated string up to the max length
         string ReadStringToNewline(size_t maxLen) {
+            if (!_stream) {
+                auto available = std::min(maxLen, Remaining());
+                auto p = (const char*)_ptr;
+                auto newline = (const char*)memchr(p, '\n', available);
+                auto len = newline ? size_t(newline - p) : available;
+                _ptr += newline ? len + 1 : len;
+                return { p, strnlen(p, len) };
+            }
+
             std::vector<char> chars;
             for (int i = 0; i < maxLen; i++) {
                 char c = (char)ReadByte();
@@ -148,6 +229,7 @@ namespace Inferno {
         uint32 ReadUInt32() { return Read<uint32>(); }
         int32 ReadInt32() { return Read<int32>(); }
         int64 ReadInt64() { return Read<int64>(); }
+        uint64 ReadUInt64() { return Read<uint64>(); }
         float ReadFloat() { return Read<float>(); }
 
         // Reads a int32 fixed value into a float
@@ -176,6 +258,26 @@ namespace Inferno {
             return v;
         }
 
+        // Reads consecutive 12 byte fixed point vectors. Memory readers bounds check the whole run once.
+        void ReadVectors(span<Vector3> dest) {
+            if (_stream) {
+                for (auto& v : dest)
+                    v = ReadVector();
+
+                return;
+            }
+
+            constexpr size_t VECTOR_SIZE = sizeof(int32) * 3;
+            auto src = Take(dest.size() * VECTOR_SIZE);
+
+            for (auto& v : dest) {
+                int32 f[3];
+                memcpy(f, src, VECTOR_SIZE);
+                v = { FixToFloat(f[0]), FixToFloat(f[1]), FixToFloat(f[2]) };
+                src += VECTOR_SIZE;
+            }
+        }
+
         // Reads a floating point vector
         Vector3 ReadVector3() {
             Vector3 v;
@@ -214,21 +316,27 @@ namespace Inferno {
         }
 
         bool EndOfStream() { 
+            if (!_stream) return _ptr >= _end;
             _stream->peek(); // need to peek to ensure EOF is correct
             return _stream->eof(); 
         }
 
         // Current stream offset
-        size_t Position() { return _stream->tellg(); }
+        size_t Position() {
+            if (!_stream) return _ptr - _begin;
+            return _stream->tellg();
+        }
 
-        // Seek from the beginning
+        // Seek from the beginning. Buffers stop at the end, so reads past it throw.
         void Seek(size_t offset) {
-            _stream->seekg(offset, std::ios_base::beg);
+            if (!_stream) _ptr = _begin + std::min(offset, size_t(_end - _begin));
+            else _stream->seekg(offset, std::ios_base::beg);
         }
 
-        // Seek forward from the current position
+        // Seek forward from the current position. Buffers stop at the end, so reads past it throw.
         void SeekForward(size_t offset) {
-            _stream->seekg(offset, std::ios_base::cur);
+            if (!_stream) _ptr += std::min(offset, Remaining());
+            else _stream->seekg(offset, std::ios_base::cur);
         }
     };
 
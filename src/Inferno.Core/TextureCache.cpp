@@ -0,0 +1,201 @@
+#include "pch.h"
+#include "TextureCache.h"
+#include "MappedFile.h"
+#include "Streams.h"
+#include "Utility.h"
+#include <fstream>
+
+namespace Inferno {
+    namespace {
+        constexpr uint32 TEXTURE_CACHE_ID = MakeFourCC("ITXC");
+        constexpr int32 TEXTURE_CACHE_VERSION = 1; // Increment when the decoded format changes
+        constexpr auto TEXTURE_CACHE_EXTENSION = ".texcache";
+
+        template<class T>
+        span<const ubyte> AsBytes(const List<T>& items) {
+            return { (const ubyte*)items.data(), items.size() * sizeof(T) };
+        }
+
+        // Reads a pixel array that is either empty or one element per pixel
+        template<class T>
+        bool ReadPixels(StreamReader& reader, List<T>& dest, size_t pixels, bool optional) {
+            auto count = reader.ReadUInt32();
+            if (count != pixels && !(optional && count == 0))
+                return false;
+
+            dest = reader.ReadArray<T>(count);
+            return true;
+        }
+    }
+
+    string TextureCacheKey::FileName() const {
+        return fmt::format("{:016x}{:016x}{}", Pig, Palette, TEXTURE_CACHE_EXTENSION);
+    }
+
+    uint64 HashBytes(span<const ubyte> data, uint64 hash) {
+        for (auto b : data) {
+            hash ^= b;
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    uint64 HashFile(const filesystem::path& path) {
+        MappedFile file(path);
+        return HashBytes(file.Data());
+    }
+
+    Option<List<PigBitmap>> TextureCache::Read(const TextureCacheKey& key, span<PigEntry> entries) const {
+        auto path = GetPath(key);
+        if (!filesystem::exists(path)) return {};
+
+        List<PigBitmap> bitmaps;
+        List<Color> averages;
+
+        try {
+            MappedFile file(path);
+            StreamReader reader(file.Data());
+
+            if (reader.ReadUInt32() != TEXTURE_CACHE_ID || reader.ReadInt32() != TEXTURE_CACHE_VERSION)
+                return {};
+
+            TextureCacheKey fileKey;
+            fileKey.Pig = reader.ReadUInt64();
+            fileKey.Palette = reader.ReadUInt64();
+            if (fileKey != key) return {};
+
+            if (reader.ReadUInt32() != entries.size())
+                return {};
+
+            bitmaps.resize(entries.size());
+            averages.resize(entries.size());
+
+            for (size_t i = 0; i < entries.size(); i++) {
+                auto& bmp = bitmaps[i];
+                auto width = reader.ReadUInt16();
+                auto height = reader.ReadUInt16();
+                if (width != entries[i].Width || height != entries[i].Height)
+                    return {};
+
+                auto& average = averages[i];
+                average.x = reader.ReadFloat();
+                average.y = reader.ReadFloat();
+                average.z = reader.ReadFloat();
+                average.w = reader.ReadFloat();
+
+                size_t pixels = width * height;
+                if (!ReadPixels(reader, bmp.Data, pixels, false) ||
+                    !ReadPixels(reader, bmp.Indexed, pixels, false) ||
+                    !ReadPixels(reader, bmp.Mask, pixels, true))
+                    return {};
+            }
+        }
+        catch (const std::exception&) {
+            return {}; // Truncated or unreadable, treat as a miss
+        }
+
+        for (size_t i = 0; i < entries.size(); i++) {
+            entries[i].AverageColor = averages[i];
+            bitmaps[i].Info = entries[i];
+        }
+
+        // Mark as recently used for eviction
+        std::error_code ec;
+        filesystem::last_write_time(path, filesystem::file_time_type::clock::now(), ec);
+        return bitmaps;
+    }
+
+    void TextureCache::Write(const TextureCacheKey& key, span<const PigBitmap> bitmaps) const {
+        filesystem::create_directories(_directory);
+        auto path = GetPath(key);
+        auto temp = path;
+        temp += ".tmp";
+
+        {
+            std::ofstream stream(temp, std::ios::binary);
+            StreamWriter writer(stream);
+            writer.Write(TEXTURE_CACHE_ID);
+            writer.Write(TEXTURE_CACHE_VERSION);
+            writer.Write(key.Pig);
+            writer.Write(key.Palette);
+            writer.Write((uint32)bitmaps.size());
+
+            for (auto& bmp : bitmaps) {
+                writer.Write(bmp.Info.Width);
+                writer.Write(bmp.Info.Height);
+
+                auto average = GetAverageColor(bmp.Data);
+                writer.WriteFloat(average.x);
+                writer.WriteFloat(average.y);
+                writer.WriteFloat(average.z);
+                writer.WriteFloat(average.w);
+
+                writer.Write((uint32)bmp.Data.size());
+                writer.WriteBytes(AsBytes(bmp.Data));
+                writer.Write((uint32)bmp.Indexed.size());
+                writer.WriteBytes(bmp.Indexed);
+                writer.Write((uint32)bmp.Mask.size());
+                writer.WriteBytes(AsBytes(bmp.Mask));
+            }
+
+            if (!stream) {
+                stream.close();
+                filesystem::remove(temp);
+                throw Exception("Unable to write texture cache");
+            }
+        }
+
+        // Replace the file only after it is complete so a failed write can't leave a corrupt cache
+        filesystem::rename(temp, path);
+        Evict();
+    }
+
+    namespace {
+        struct CacheFile {
+            filesystem::path Path;
+            uintmax_t Size;
+            filesystem::file_time_type LastUsed;
+        };
+
+        List<CacheFile> FindCacheFiles(const filesystem::path& directory) {
+            List<CacheFile> files;
+            std::error_code ec;
+            if (!filesystem::exists(directory, ec)) return files;
+
+            for (auto& entry : filesystem::directory_iterator(directory, ec)) {
+                if (!entry.is_regular_file() || entry.path().extension() != TEXTURE_CACHE_EXTENSION)
+                    continue;
+
+                files.push_back({ entry.path(), entry.file_size(), entry.last_write_time() });
+            }
+
+            return files;
+        }
+    }
+
+    void TextureCache::Evict() const {
+        auto files = FindCacheFiles(_directory);
+        uintmax_t total = 0;
+        for (auto& file : files)
+            total += file.Size;
+
+        Seq::sortBy(files, [](const CacheFile& a, const CacheFile& b) { return a.LastUsed < b.LastUsed; });
+
+        for (auto& file : files) {
+            if (total <= _maxSize) break;
+
+            // Files in use by another instance can't be removed on Windows
+            std::error_code ec;
+            if (filesystem::remove(file.Path, ec))
+                total -= file.Size;
+        }
+    }
+
+    void TextureCache::Clear() const {
+        for (auto& file : FindCacheFiles(_directory)) {
+            std::error_code ec;
+            filesystem::remove(file.Path, ec);
+        }
+    }
+}
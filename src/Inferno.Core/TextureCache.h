@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Types.h"
+#include "Pig.h"
+
+namespace Inferno {
+    // Identifies the inputs of a decoded texture set. Any change to the PIG or palette produces a new key.
+    struct TextureCacheKey {
+        uint64 Pig = 0; // Hash of the PIG file contents
+        uint64 Palette = 0; // Hash of the palette file contents
+
+        // Name of the cache file for this key
+        string FileName() const;
+
+        bool operator==(const TextureCacheKey&) const = default;
+    };
+
+    // 64-bit FNV-1a hash
+    uint64 HashBytes(span<const ubyte> data, uint64 hash = 14695981039346656037ull);
+
+    // Hashes the contents of a file by mapping it
+    uint64 HashFile(const filesystem::path& path);
+
+    // Stores decoded PIG bitmaps and their average colors on disk so they can be loaded without decoding.
+    // Each key is stored in its own file. The least recently used files are removed when over the size limit.
+    class TextureCache {
+        filesystem::path _directory;
+        uintmax_t _maxSize; // Bytes
+
+    public:
+        TextureCache(filesystem::path directory, uintmax_t maxSize)
+            : _directory(std::move(directory)), _maxSize(maxSize) {}
+
+        filesystem::path GetPath(const TextureCacheKey& key) const { return _directory / key.FileName(); }
+
+        // Reads the cached bitmaps for a key and copies the average colors into the entries.
+        // Returns empty if the file doesn't exist, is from an older version, or doesn't match the entries.
+        Option<List<PigBitmap>> Read(const TextureCacheKey& key, span<PigEntry> entries) const;
+
+        // Writes bitmaps to the cache, then evicts old files if the cache is over the size limit.
+        void Write(const TextureCacheKey& key, span<const PigBitmap> bitmaps) const;
+
+        // Removes the least recently used files until the cache is under the size limit
+        void Evict() const;
+
+        // Removes all cache files
+        void Clear() const;
+    };
+}
@@ -0,0 +1,332 @@
+#include "pch.h"
+#include <bit>
+#include <intrin.h>
+#include <immintrin.h>
+#include "TriangleBvh.h"
+
+// The kernels must produce identical results, so don't let the optimizer reorder or fuse floating point math
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+
+namespace Inferno {
+    namespace {
+        // Padding added to node bounds. Keeps flat boxes from axis aligned triangles from being missed.
+        constexpr float BOUNDS_PADDING = 0.01f;
+        constexpr float RAY_EPSILON = 1e-20f; // Same as the DirectX ray triangle test
+
+        struct RayData {
+            float Ox, Oy, Oz;
+            float Dx, Dy, Dz;
+            float MaxDist;
+        };
+
+        // Tests one lane of a block. This is the reference for the SIMD kernels, which perform the same operations.
+        bool TestLane(const TriangleBvh::TriangleBlock& b, uint32 i, const RayData& r, int& tests) {
+            auto facing = b.Nx[i] * r.Dx + b.Ny[i] * r.Dy + b.Nz[i] * r.Dz;
+            if (b.OneSided[i] && facing > 0) return false; // Ray is travelling out of the back
+            tests++;
+
+            auto px = r.Dy * b.E2z[i] - r.Dz * b.E2y[i];
+            auto py = r.Dz * b.E2x[i] - r.Dx * b.E2z[i];
+            auto pz = r.Dx * b.E2y[i] - r.Dy * b.E2x[i];
+            auto det = b.E1x[i] * px + b.E1y[i] * py + b.E1z[i] * pz;
+
+            auto sx = r.Ox - b.V0x[i];
+            auto sy = r.Oy - b.V0y[i];
+            auto sz = r.Oz - b.V0z[i];
+            auto u = sx * px + sy * py + sz * pz;
+
+            auto qx = sy * b.E1z[i] - sz * b.E1y[i];
+            auto qy = sz * b.E1x[i] - sx * b.E1z[i];
+            auto qz = sx * b.E1y[i] - sy * b.E1x[i];
+            auto v = r.Dx * qx + r.Dy * qy + r.Dz * qz;
+            auto uv = u + v;
+
+            bool hit = false;
+            if (det >= RAY_EPSILON)
+                hit = !(u < 0 || u > det || v < 0 || uv > det); // Front side
+            else if (det <= -RAY_EPSILON)
+                hit = !(u > 0 || u < det || v > 0 || uv < det); // Back side
+
+            if (!hit) return false; // Parallel or outside
+
+            auto t = (b.E2x[i] * qx + b.E2y[i] * qy + b.E2z[i] * qz) * (1.0f / det);
+            return t >= 0 && t < r.MaxDist;
+        }
+
+        // Tests four lanes of a block starting at offset. Returns a bit mask of the lanes that hit.
+        int HitMaskSSE(const TriangleBvh::TriangleBlock& b, uint32 offset, uint32 count, const RayData& r, int& tests) {
+            auto load = [offset](const float* src) { return _mm_load_ps(src + offset); };
+            auto dot = [](__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+                return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+            };
+
+            auto zero = _mm_setzero_ps();
+            auto dx = _mm_set1_ps(r.Dx), dy = _mm_set1_ps(r.Dy), dz = _mm_set1_ps(r.Dz);
+
+            auto facing = dot(load(b.Nx), load(b.Ny), load(b.Nz), dx, dy, dz);
+            auto backFacing = _mm_and_ps(load((const float*)b.OneSided), _mm_cmpgt_ps(facing, zero));
+            auto lanes = _mm_add_ps(_mm_setr_ps(0, 1, 2, 3), _mm_set1_ps((float)offset));
+            auto active = _mm_andnot_ps(backFacing, _mm_cmplt_ps(lanes, _mm_set1_ps((float)count)));
+            auto activeMask = _mm_movemask_ps(active);
+            if (activeMask == 0) return 0;
+            tests += std::popcount((uint)activeMask);
+
+            auto e1x = load(b.E1x), e1y = load(b.E1y), e1z = load(b.E1z);
+            auto e2x = load(b.E2x), e2y = load(b.E2y), e2z = load(b.E2z);
+
+            auto px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            auto py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            auto pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+            auto det = dot(e1x, e1y, e1z, px, py, pz);
+
+            auto sx = _mm_sub_ps(_mm_set1_ps(r.Ox), load(b.V0x));
+            auto sy = _mm_sub_ps(_mm_set1_ps(r.Oy), load(b.V0y));
+            auto sz = _mm_sub_ps(_mm_set1_ps(r.Oz), load(b.V0z));
+            auto u = dot(sx, sy, sz, px, py, pz);
+
+            auto qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+            auto qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+            auto qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+            auto v = dot(dx, dy, dz, qx, qy, qz);
+            auto uv = _mm_add_ps(u, v);
+
+            auto front = _mm_cmpge_ps(det, _mm_set1_ps(RAY_EPSILON));
+            auto missFront = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmpgt_ps(u, det)),
+                                       _mm_or_ps(_mm_cmplt_ps(v, zero), _mm_cmpgt_ps(uv, det)));
+
+            auto back = _mm_cmple_ps(det, _mm_set1_ps(-RAY_EPSILON));
+            auto missBack = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmplt_ps(u, det)),
+                                      _mm_or_ps(_mm_cmpgt_ps(v, zero), _mm_cmplt_ps(uv, det)));
+
+            auto hit = _mm_or_ps(_mm_andnot_ps(missFront, front), _mm_andnot_ps(missBack, back));
+
+            auto t = _mm_mul_ps(dot(e2x, e2y, e2z, qx, qy, qz), _mm_div_ps(_mm_set1_ps(1.0f), det));
+            hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmplt_ps(t, _mm_set1_ps(r.MaxDist))));
+            return _mm_movemask_ps(_mm_and_ps(hit, active));
+        }
+
+        // Tests all eight lanes of a block. Returns a bit mask of the lanes that hit.
+        int HitMaskAVX(const TriangleBvh::TriangleBlock& b, uint32 count, const RayData& r, int& tests) {
+            auto dot = [](__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz) {
+                return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+            };
+
+            auto zero = _mm256_setzero_ps();
+            auto dx = _mm256_set1_ps(r.Dx), dy = _mm256_set1_ps(r.Dy), dz = _mm256_set1_ps(r.Dz);
+
+            auto facing = dot(_mm256_load_ps(b.Nx), _mm256_load_ps(b.Ny), _mm256_load_ps(b.Nz), dx, dy, dz);
+            auto backFacing = _mm256_and_ps(_mm256_load_ps((const float*)b.OneSided), _mm256_cmp_ps(facing, zero, _CMP_GT_OQ));
+            auto lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+            auto active = _mm256_andnot_ps(backFacing, _mm256_cmp_ps(lanes, _mm256_set1_ps((float)count), _CMP_LT_OQ));
+            auto activeMask = _mm256_movemask_ps(active);
+            if (activeMask == 0) return 0;
+            tests += std::popcount((uint)activeMask);
+
+            auto e1x = _mm256_load_ps(b.E1x), e1y = _mm256_load_ps(b.E1y), e1z = _mm256_load_ps(b.E1z);
+            auto e2x = _mm256_load_ps(b.E2x), e2y = _mm256_load_ps(b.E2y), e2z = _mm256_load_ps(b.E2z);
+
+            auto px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+            auto py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+            auto pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+            auto det = dot(e1x, e1y, e1z, px, py, pz);
+
+            auto sx = _mm256_sub_ps(_mm256_set1_ps(r.Ox), _mm256_load_ps(b.V0x));
+            auto sy = _mm256_sub_ps(_mm256_set1_ps(r.Oy), _mm256_load_ps(b.V0y));
+            auto sz = _mm256_sub_ps(_mm256_set1_ps(r.Oz), _mm256_load_ps(b.V0z));
+            auto u = dot(sx, sy, sz, px, py, pz);
+
+            auto qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+            auto qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+            auto qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+            auto v = dot(dx, dy, dz, qx, qy, qz);
+            auto uv = _mm256_add_ps(u, v);
+
+            auto front = _mm256_cmp_ps(det, _mm256_set1_ps(RAY_EPSILON), _CMP_GE_OQ);
+            auto missFront = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_LT_OQ), _mm256_cmp_ps(u, det, _CMP_GT_OQ)),
+                                          _mm256_or_ps(_mm256_cmp_ps(v, zero, _CMP_LT_OQ), _mm256_cmp_ps(uv, det, _CMP_GT_OQ)));
+
+            auto back = _mm256_cmp_ps(det, _mm256_set1_ps(-RAY_EPSILON), _CMP_LE_OQ);
+            auto missBack = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_GT_OQ), _mm256_cmp_ps(u, det, _CMP_LT_OQ)),
+                                         _mm256_or_ps(_mm256_cmp_ps(v, zero, _CMP_GT_OQ), _mm256_cmp_ps(uv, det, _CMP_LT_OQ)));
+
+            auto hit = _mm256_or_ps(_mm256_andnot_ps(missFront, front), _mm256_andnot_ps(missBack, back));
+
+            auto t = _mm256_mul_ps(dot(e2x, e2y, e2z, qx, qy, qz), _mm256_div_ps(_mm256_set1_ps(1.0f), det));
+            hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(r.MaxDist), _CMP_LT_OQ)));
+            return _mm256_movemask_ps(_mm256_and_ps(hit, active));
+        }
+
+        bool IntersectsBounds(const Vector3& min, const Vector3& max, const Vector3& origin, const Vector3& invDir, float maxDist) {
+            auto t1 = (min - origin) * invDir;
+            auto t2 = (max - origin) * invDir;
+
+            auto tmin = std::max({ std::min(t1.x, t2.x), std::min(t1.y, t2.y), std::min(t1.z, t2.z) });
+            auto tmax = std::min({ std::max(t1.x, t2.x), std::max(t1.y, t2.y), std::max(t1.z, t2.z) });
+            return tmax >= std::max(tmin, 0.0f) && tmin <= maxDist;
+        }
+    }
+
+    TriangleBvh::TriangleBvh(List<Triangle> triangles) {
+        if (triangles.empty()) return;
+
+        List<Vector3> centroids(triangles.size());
+        List<uint32> order(triangles.size());
+
+        for (uint32 i = 0; i < triangles.size(); i++) {
+            auto& tri = triangles[i];
+            centroids[i] = (tri.V0 + tri.V1 + tri.V2) / 3;
+            order[i] = i;
+        }
+
+        _nodes.reserve(triangles.size() * 4 / MAX_LEAF_SIZE + 1);
+        BuildNode(triangles, order, centroids, 0, (uint32)triangles.size());
+        _triangleCount = triangles.size();
+
+        // Copy the triangles of each leaf into a block
+        for (auto& node : _nodes) {
+            if (node.Count == 0) continue;
+
+            TriangleBlock block{};
+            for (uint32 i = 0; i < node.Count; i++) {
+                auto& tri = triangles[order[node.Index + i]];
+                auto e1 = tri.V1 - tri.V0;
+                auto e2 = tri.V2 - tri.V0;
+
+                block.V0x[i] = tri.V0.x;
+                block.V0y[i] = tri.V0.y;
+                block.V0z[i] = tri.V0.z;
+                block.E1x[i] = e1.x;
+                block.E1y[i] = e1.y;
+                block.E1z[i] = e1.z;
+                block.E2x[i] = e2.x;
+                block.E2y[i] = e2.y;
+                block.E2z[i] = e2.z;
+                block.Nx[i] = tri.Normal.x;
+                block.Ny[i] = tri.Normal.y;
+                block.Nz[i] = tri.Normal.z;
+                block.OneSided[i] = tri.OneSided ? ~0u : 0;
+            }
+
+            node.Index = (uint32)_blocks.size();
+            _blocks.push_back(block);
+        }
+    }
+
+    uint32 TriangleBvh::BuildNode(const List<Triangle>& triangles, List<uint32>& order, const List<Vector3>& centroids, uint32 begin, uint32 end) {
+        auto nodeIndex = (uint32)_nodes.size();
+        _nodes.emplace_back();
+
+        Vector3 min(FLT_MAX), max(-FLT_MAX);
+        Vector3 centerMin(FLT_MAX), centerMax(-FLT_MAX);
+
+        for (uint32 i = begin; i < end; i++) {
+            auto& tri = triangles[order[i]];
+            min = Vector3::Min(min, Vector3::Min(tri.V0, Vector3::Min(tri.V1, tri.V2)));
+            max = Vector3::Max(max, Vector3::Max(tri.V0, Vector3::Max(tri.V1, tri.V2)));
+            centerMin = Vector3::Min(centerMin, centroids[order[i]]);
+            centerMax = Vector3::Max(centerMax, centroids[order[i]]);
+        }
+
+        // Not a reference, building the children can reallocate the nodes
+        Node node;
+        node.Min = min - Vector3(BOUNDS_PADDING);
+        node.Max = max + Vector3(BOUNDS_PADDING);
+
+        // Split at the median centroid of the longest axis
+        auto extent = centerMax - centerMin;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        // Always split by count, even if the centroids overlap, so every leaf fits in a block
+        if (end - begin <= MAX_LEAF_SIZE) {
+            node.Index = begin;
+            node.Count = end - begin;
+        }
+        else {
+            auto mid = begin + (end - begin) / 2;
+            auto axisValue = [&centroids, axis](uint32 i) {
+                auto& c = centroids[i];
+                return axis == 0 ? c.x : axis == 1 ? c.y : c.z;
+            };
+
+            std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                             [&axisValue](uint32 a, uint32 b) { return axisValue(a) < axisValue(b); });
+
+            BuildNode(triangles, order, centroids, begin, mid); // Left child is always the next node
+            node.Index = BuildNode(triangles, order, centroids, mid, end);
+        }
+
+        _nodes[nodeIndex] = node;
+        return nodeIndex;
+    }
+
+    template<BvhKernel TKernel>
+    bool TriangleBvh::Traverse(const Ray& ray, float maxDist, int& tests) const {
+        if (_nodes.empty()) return false;
+
+        auto& dir = ray.direction;
+        RayData r = { ray.position.x, ray.position.y, ray.position.z, dir.x, dir.y, dir.z, maxDist };
+        Vector3 invDir(1 / dir.x, 1 / dir.y, 1 / dir.z);
+
+        constexpr int STACK_SIZE = 64;
+        uint32 stack[STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            auto index = stack[--top];
+            auto& node = _nodes[index];
+            if (!IntersectsBounds(node.Min, node.Max, ray.position, invDir, maxDist)) continue;
+
+            if (node.Count > 0) {
+                auto& block = _blocks[node.Index];
+
+                if constexpr (TKernel == BvhKernel::AVX) {
+                    if (HitMaskAVX(block, node.Count, r, tests)) return true;
+                }
+                else if constexpr (TKernel == BvhKernel::SSE) {
+                    if (HitMaskSSE(block, 0, node.Count, r, tests)) return true;
+                    if (node.Count > 4 && HitMaskSSE(block, 4, node.Count, r, tests)) return true;
+                }
+                else {
+                    for (uint32 i = 0; i < node.Count; i++)
+                        if (TestLane(block, i, r, tests)) return true;
+                }
+            }
+            else {
+                assert(top + 2 <= STACK_SIZE);
+                stack[top++] = node.Index; // Right
+                stack[top++] = index + 1; // Left
+            }
+        }
+
+        return false;
+    }
+
+    bool TriangleBvh::AnyHit(const Ray& ray, float maxDist, int& tests) const {
+        switch (_kernel) {
+            case BvhKernel::AVX: return Traverse<BvhKernel::AVX>(ray, maxDist, tests);
+            case BvhKernel::SSE: return Traverse<BvhKernel::SSE>(ray, maxDist, tests);
+            default: return Traverse<BvhKernel::Scalar>(ray, maxDist, tests);
+        }
+    }
+
+    BvhKernel GetBestBvhKernel() {
+        static const BvhKernel kernel = [] {
+            int info[4]{};
+            __cpuid(info, 1);
+            bool osxsave = info[2] & (1 << 27);
+            bool avx = info[2] & (1 << 28);
+
+            // The OS must also save the AVX registers on context switches
+            if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+                return BvhKernel::AVX;
+
+            return BvhKernel::SSE; // Always available on x64
+        }();
+
+        return kernel;
+    }
+}
+
+#pragma float_control(pop)
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Types.h"
+
+namespace Inferno {
+    // Instruction set used to test a ray against the triangles in a BVH leaf
+    enum class BvhKernel {
+        Scalar, // One triangle at a time
+        SSE, // Four triangles per instruction
+        AVX // Eight triangles per instruction
+    };
+
+    // Returns the widest kernel supported by this CPU
+    BvhKernel GetBestBvhKernel();
+
+    // Bounding volume hierarchy over a static set of triangles, used for occlusion queries.
+    // Nodes are stored depth first in a single array so the left child of a node always follows it.
+    // Each leaf stores its triangles in a structure of arrays block so one ray can be tested against all of them at once.
+    // Every kernel performs the same operations in the same order, so they return identical results.
+    class TriangleBvh {
+    public:
+        struct Triangle {
+            Vector3 V0, V1, V2;
+            Vector3 Normal; // Facing used by one sided triangles
+            bool OneSided = false; // Only blocks rays travelling against the normal
+        };
+
+        static constexpr uint32 MAX_LEAF_SIZE = 8;
+
+        // Triangles of a leaf. Unused lanes have zero length edges and never hit.
+        struct alignas(32) TriangleBlock {
+            float V0x[MAX_LEAF_SIZE], V0y[MAX_LEAF_SIZE], V0z[MAX_LEAF_SIZE];
+            float E1x[MAX_LEAF_SIZE], E1y[MAX_LEAF_SIZE], E1z[MAX_LEAF_SIZE]; // V1 - V0
+            float E2x[MAX_LEAF_SIZE], E2y[MAX_LEAF_SIZE], E2z[MAX_LEAF_SIZE]; // V2 - V0
+            float Nx[MAX_LEAF_SIZE], Ny[MAX_LEAF_SIZE], Nz[MAX_LEAF_SIZE];
+            uint32 OneSided[MAX_LEAF_SIZE]; // All bits set for one sided triangles
+        };
+
+    private:
+        struct Node {
+            Vector3 Min;
+            uint32 Index = 0; // Triangle block for leaves, right child for interior nodes
+            Vector3 Max;
+            uint32 Count = 0; // Triangles in a leaf. Zero for interior nodes.
+        };
+
+        static_assert(sizeof(Node) == 32);
+
+        List<Node> _nodes;
+        List<TriangleBlock> _blocks;
+        size_t _triangleCount = 0;
+        BvhKernel _kernel = GetBestBvhKernel();
+
+        uint32 BuildNode(const List<Triangle>& triangles, List<uint32>& order, const List<Vector3>& centroids, uint32 begin, uint32 end);
+
+        template<BvhKernel TKernel>
+        bool Traverse(const Ray& ray, float maxDist, int& tests) const;
+
+    public:
+        TriangleBvh() = default;
+        TriangleBvh(List<Triangle> triangles);
+
+        // Returns true if the ray hits any triangle closer than maxDist. Stops at the first leaf with a hit.
+        // Adds the number of triangle intersection tests to tests.
+        bool AnyHit(const Ray& ray, float maxDist, int& tests) const;
+
+        // Overrides the kernel used by AnyHit. Kernels the CPU doesn't support fall back to the best supported one.
+        void SetKernel(BvhKernel kernel) { _kernel = std::min(kernel, GetBestBvhKernel()); }
+        BvhKernel GetKernel() const { return _kernel; }
+
+        size_t TriangleCount() const { return _triangleCount; }
+        size_t NodeCount() const { return _nodes.size(); }
+    };
+}
@@ -643,4 +643,29 @@ namespace Inferno {
 
         return String::InvariantEquals(path.extension().wstring(), ext);
     }
+
+    namespace File {
+        // Where a file is written before it replaces the destination. Appends to the name so files
+        // that only differ by extension don't share a temporary file.
+        inline filesystem::path TemporaryPath(filesystem::path path) {
+            return path += ".tmp";
+        }
+
+        // Renames temp over path in a single step, so an interrupted write can't leave a partial file.
+        // If backupExtension is not empty the previous file is kept with that extension.
+        inline void ReplaceWithBackup(const filesystem::path& temp, const filesystem::path& path, string_view backupExtension) {
+            if (!backupExtension.empty() && filesystem::exists(path)) {
+                filesystem::path backup = path;
+                backup.replace_extension(backupExtension);
+
+                // A hard link keeps the old contents without copying them. Fall back to a copy on file systems without links.
+                std::error_code ec;
+                filesystem::remove(backup, ec);
+                filesystem::create_hard_link(path, backup, ec);
+                if (ec) filesystem::copy_file(path, backup, filesystem::copy_options::overwrite_existing);
+            }
+
+            filesystem::rename(temp, path);
+        }
+    }
 }
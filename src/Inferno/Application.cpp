@@ -98,16 +98,17 @@ void Application::Update() {
     }
 
     constexpr double dt = 1.0f / 64;
+    constexpr double MAX_FRAME_TIME = 0.25; // Drop time after a long stall instead of stepping physics many times to catch up
     static double accumulator = 0;
     static double t = 0;
 
-    accumulator += Render::FrameTime;
-
     Render::Debug::BeginFrame(); // enable Debug calls during physics
 
     float alpha = 1; // blending between previous and current position
 
     if (Settings::Editor.EnablePhysics) {
+        accumulator += std::min((double)Render::FrameTime, MAX_FRAME_TIME);
+
         while (accumulator >= dt) {
             UpdatePhysics(Game::Level, t, dt); // catch up if physics falls behind
             accumulator -= dt;
@@ -116,6 +117,9 @@ void Application::Update() {
 
         alpha = float(accumulator / dt);
     }
+    else {
+        accumulator = 0; // Don't catch up on the time physics was disabled
+    }
 
     Render::UpdateParticles(Render::FrameTime);
     Editor::Update();
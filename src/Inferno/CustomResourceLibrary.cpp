@@ -129,34 +129,35 @@ namespace Inferno {
         auto& gamePalette = Resources::GetPalette();
         PaletteLookup lookup(gamePalette);
 
+        // Map the bitmap palette to the game palette once instead of per pixel
+        auto gameIndices = lookup.QuantizeImage(bmpPalette.Data, transparent);
+
         // Index closest to white when using the "white as transparent" option
-        PaletteLookup bmpLookup(bmpPalette);
-        auto whiteIndex = bmpLookup.GetClosestIndex({ 255, 255, 255 }, true);
+        auto whiteIndex = PaletteLookup(bmpPalette).GetClosestIndex({ 255, 255, 255 }, true);
 
         // read data into bitmap
         int width = ((int)(bmih.biWidth * bmih.biBitCount + 31) >> 3) & ~3;
+        List<ubyte> row(width);
         int z = 0;
         for (int y = 0; y < bmp.Info.Height; y++) {
+            int v = !topDown ? bmih.biHeight - y - 1 : y;
+            stream.Seek((int)bmfh.bfOffBits + v * width);
+            stream.ReadBytes(row);
+
             for (int x = 0; x < bmp.Info.Width; x++, z++) {
-                int u = x;
-                int v = !topDown ? bmih.biHeight - y - 1 : y;
                 ubyte palIndex{};
 
                 if (bmih.biBitCount == 4) {
-                    long offset = v * width + u / 2;
-                    stream.Seek((int)bmfh.bfOffBits + offset);
-                    palIndex = stream.ReadByte();
-                    if (!(u & 1))
+                    palIndex = row[x / 2];
+                    if (!(x & 1))
                         palIndex >>= 4;
                     palIndex &= 0x0f;
                 }
                 else {
-                    stream.Seek((int)bmfh.bfOffBits + v * width + u);
-                    palIndex = stream.ReadByte();
+                    palIndex = row[x];
                 }
 
-                auto& c = bmpPalette.Data[palIndex];
-                bmp.Indexed[z] = lookup.GetClosestIndex(c, transparent);
+                bmp.Indexed[z] = gameIndices[palIndex];
                 bmp.Data[z] = gamePalette.Data[bmp.Indexed[z]];
 
                 if (transparent) {
@@ -186,11 +187,8 @@ namespace Inferno {
     }
 
     void WriteBitmap(StreamWriter& writer, PaletteLookup& lookup, const PigBitmap& bitmap) {
-        for (auto& pixel : bitmap.Data) {
-            // convert color to index and write byte
-            auto index = lookup.GetClosestIndex(pixel, bitmap.Info.Transparent);
-            writer.Write<ubyte>(index);
-        }
+        // convert colors to indices and write them
+        writer.WriteBytes(lookup.QuantizeImage(bitmap.Data, bitmap.Info.Transparent));
     }
 
     size_t CustomResourceLibrary::WritePog(StreamWriter& writer, const Palette& palette) {
@@ -215,7 +213,6 @@ namespace Inferno {
         }
 
         // write bitmap data
-        PaletteLookup lookup(palette);
         for (auto& id : ids)
             writer.WriteBytes(_textures[id].Indexed);
 
@@ -248,7 +245,6 @@ namespace Inferno {
         }
 
         // write bitmap data
-        PaletteLookup lookup(palette);
         for (auto& id : ids)
             writer.WriteBytes(_textures[id].Indexed);
 
@@ -284,11 +280,12 @@ namespace Inferno {
             pigEntries[(int)id] = ReadD2BitmapHeader(reader, id);
 
         auto dataStart = reader.Position();
+        auto entries = Seq::map(ids, [&](TexID id) { return pigEntries[(int)id]; });
+        auto bitmaps = ReadBitmaps(data, dataStart, entries, palette);
 
-        for (auto& id : ids) {
-            auto& entry = pigEntries[(int)id];
-            _textures[id] = ReadBitmapEntry(reader, dataStart, entry, palette);
-            _textures[id].Info.Custom = true;
+        for (size_t i = 0; i < ids.size(); i++) {
+            bitmaps[i].Info.Custom = true;
+            _textures[ids[i]] = std::move(bitmaps[i]);
         }
 
         SPDLOG_INFO("Loaded {} custom textures from POG", ids.size());
@@ -324,9 +321,8 @@ namespace Inferno {
 
         auto dataStart = reader.Position();
 
-        for (auto& entry : entries) {
-            _textures[entry.ID] = ReadBitmapEntry(reader, dataStart, entry, palette);
-        }
+        for (auto& bitmap : ReadBitmaps(data, dataStart, entries, palette))
+            _textures[bitmap.Info.ID] = std::move(bitmap);
 
         for (auto& entry : sounds) {
             //SPDLOG_INFO("{}:{} offset {}", entry.Name, entry.DataLength, entry.Offset);
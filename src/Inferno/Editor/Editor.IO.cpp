@@ -10,11 +10,13 @@
 #include "Editor.h"
 #include "Graphics/Render.h"
 #include "Editor.Diagnostics.h"
+#include "FileSystem.h"
 
 namespace Inferno::Editor {
     constexpr auto METADATA_EXTENSION = "ied"; // inferno engine data
 
-    size_t SaveLevel(Level& level, StreamWriter& writer) {
+    // Fixes up the level before it is serialized
+    void PrepareLevelForSave(Level& level) {
         if (level.Walls.size() >= (int)WallID::Max)
             throw Exception("Cannot save a level with more than 255 walls");
 
@@ -28,70 +30,18 @@ namespace Inferno::Editor {
                 level.SecretReturnOrientation = obj.Rotation;
             }
         }
-        return level.Serialize(writer);
     }
 
-    // Saves a level to the file system
-    void SaveLevelToPath(Level& level, std::filesystem::path path, bool autosave = false) {
-        CleanLevel(level);
-
-        filesystem::path temp = path;
-        temp.replace_extension("tmp");
-
-        {
-            // Write to temp file
-            std::ofstream file(temp, std::ios::binary);
-            StreamWriter writer(file, false);
-            SaveLevel(Game::Level, writer);
-        }
-
-        if (filesystem::exists(path)) {
-            // Backup the current file
-            filesystem::path backup = path;
-            backup.replace_extension("bak");
-            filesystem::copy_file(path, backup, filesystem::copy_options::overwrite_existing);
-        }
-
-        // Replace the current from temp
-        filesystem::copy_file(temp, path, filesystem::copy_options::overwrite_existing);
-        filesystem::remove(temp);
-
-        filesystem::path metadataPath = path;
-        metadataPath.replace_extension(METADATA_EXTENSION);
-        std::ofstream metadata(metadataPath);
-        level.CameraPosition = Render::Camera.Position;
-        level.CameraTarget = Render::Camera.Target;
-        level.CameraUp = Render::Camera.Up;
-        SaveLevelMetadata(level, metadata, EditorLightSettings);
-        SetStatusMessage(L"Saved level to {}", path.wstring());
+    void FinishBackgroundSave();
 
-        // Save custom textures
-        if (Resources::CustomResources.Any()) {
-            auto ext = level.IsDescent1() ? ".dtx" : ".pog";
-            filesystem::path texPath = path;
-            texPath.replace_extension(ext);
-            std::ofstream file(texPath, std::ios::binary);
-            StreamWriter writer(file, false);
-
-            if (level.IsDescent1()) {
-                Resources::CustomResources.WriteDtx(writer, Resources::GetPalette());
-            }
-            else {
-                Resources::CustomResources.WritePog(writer, Resources::GetPalette());
-            }
-        }
-
-        if (!autosave) {
-            Editor::History.UpdateCleanSnapshot();
-            Game::Level.Path = path;
-            Game::Level.FileName = path.filename().string();
-            UpdateWindowTitle();
-            History.UpdateCleanSnapshot();
-        }
+    size_t SaveLevel(Level& level, StreamWriter& writer) {
+        PrepareLevelForSave(level);
+        return level.Serialize(writer);
     }
 
     // Loads a D1 to D2 Vertigo level (no XL)
     void LoadLevel(std::filesystem::path path) {
+        FinishBackgroundSave(); // The save updates the level it was started from when it finishes
         std::ifstream file(path, std::ios::binary);
         if (!file) throw Exception("File does not exist");
 
@@ -100,7 +50,9 @@ namespace Inferno::Editor {
         if (!file.read((char*)buffer.data(), size))
             throw Exception("Error reading file");
 
-        auto level = Level::Deserialize(buffer);
+        LevelReadTimes times;
+        auto level = Level::Deserialize(buffer, &times);
+        SPDLOG_INFO("Read {} in {}", path.filename().string(), times.Format());
         level.FileName = path.filename().string();
         level.Path = path;
 
@@ -135,22 +87,35 @@ namespace Inferno::Editor {
         return -1;
     }
 
-    void AppendVertigoData(HogWriter& writer, string hamName) {
+    // Reads the Vertigo ham from d2x.hog. Returns empty if it isn't found.
+    Option<List<ubyte>> ReadVertigoData() {
         try {
-            //if (mission.ContainsFileType(".ham")) return; // Already has ham data
             if (!Resources::FoundVertigo()) {
                 SPDLOG_WARN("Level is marked as Vertigo but has no .ham and d2x.hog was not found");
-                return;
+                return {};
             }
 
-            // Insert vertigo data
             auto d2xhog = HogFile::Read(FileSystem::FindFile(L"d2x.hog"));
-            auto vertigoData = d2xhog.ReadEntry("d2x.ham");
-            writer.WriteEntry(hamName, vertigoData);
-            SPDLOG_INFO("Copied Vertigo d2x.ham into HOG");
+            return d2xhog.ReadEntry("d2x.ham");
         }
         catch (const std::exception& e) {
             SPDLOG_ERROR("Unable to add vertigo data: {}", e.what());
+            return {};
+        }
+    }
+
+    void AppendVertigoData(HogUpdate& update, string hamName) {
+        //if (mission.ContainsFileType(".ham")) return; // Already has ham data
+        if (auto data = ReadVertigoData()) {
+            update.WriteEntry(hamName, std::move(*data));
+            SPDLOG_INFO("Copied Vertigo d2x.ham into HOG");
+        }
+    }
+
+    void AppendVertigoData(HogWriter& writer, string hamName) {
+        if (auto data = ReadVertigoData()) {
+            writer.WriteEntry(hamName, *data);
+            SPDLOG_INFO("Copied Vertigo d2x.ham into HOG");
         }
     }
 
@@ -166,91 +131,247 @@ namespace Inferno::Editor {
     }
 
     // Serializes level settings to bytes
-    std::vector<ubyte> SerializeLevelMetadata(const Level& level) {
+    std::vector<ubyte> SerializeLevelMetadata(const Level& level, LightSettings& lightSettings) {
         std::stringstream stream;
         stream.unsetf(std::ios::skipws);
-        SaveLevelMetadata(level, stream, EditorLightSettings);
+        SaveLevelMetadata(level, stream, lightSettings);
         std::vector<ubyte> data(stream.tellp());
         stream.read((char*)data.data(), data.size());
         return data;
     }
 
-    // Writes a HOG file and updates the level
-    void WriteHog(Level& level, HogFile& mission, filesystem::path path) {
-        filesystem::path tempPath = path;
-        tempPath.replace_extension(".tmp");
+    // Copy of the data written by a save. Taken on the main thread so the files can be written on a worker.
+    struct LevelSnapshot {
+        Level SavedLevel;
+        LightSettings Lighting;
+        List<ubyte> Textures; // Custom textures as a DTX or POG
+    };
 
-        try {
-            if (level.FileName.empty())
-                throw Exception("Level filename is empty!");
+    // Fixes the level and copies it. The fixes are applied to the live level because they can change the selection.
+    LevelSnapshot TakeSnapshot(Level& level, bool descent1) {
+        PrepareLevelForSave(level);
+        LevelSnapshot snapshot{ level, EditorLightSettings };
 
-            auto baseName = String::NameWithoutExtension(level.FileName);
-            auto metadataName = baseName + "." + METADATA_EXTENSION;
-            HogWriter writer(tempPath); // write to temp
-            fmt::println("Copying existing HOG files:");
-
-            for (auto& entry : mission.Entries) {
-                // Does the file match the level name?
-                if (entry.NameWithoutExtension() == baseName) {
-                    // Skip files serialized later
-                    constexpr std::array skippedExtensions = { ".dtx", ".pog", ".rl2", ".rdl", ".ied" };
-                    auto ext = String::ToLower(entry.Extension());
-                    if (Seq::contains(skippedExtensions, ext))
-                        continue;
-                }
+        if (Resources::CustomResources.Any()) {
+            snapshot.Textures = SerializeToMemory([descent1](StreamWriter& w) {
+                return descent1
+                    ? Resources::CustomResources.WriteDtx(w, Resources::GetPalette())
+                    : Resources::CustomResources.WritePog(w, Resources::GetPalette());
+            });
+        }
+
+        return snapshot;
+    }
 
-                auto data = mission.ReadEntry(entry);
-                writer.WriteEntry(entry.Name, data);
-                fmt::print("{}:{}\n", entry.Name, data.size());
+    // Writes level files on a worker thread so saving doesn't stall the editor.
+    // Results are published through Events::LevelSaved on the main thread.
+    class SaveWorker {
+        std::thread _thread;
+        std::atomic<bool> _finished = false;
+        SaveResult _result;
+        std::function<void()> _commit; // Runs on the main thread after the worker, such as replacing a file the main thread has open
+        std::function<void()> _onSaved; // Runs on the main thread after a successful save
+
+        void Publish() {
+            if (_result.Error.empty() && _commit) {
+                try {
+                    _commit();
+                }
+                catch (const std::exception& e) {
+                    _result.Error = e.what();
+                }
             }
 
+            if (_result.Error.empty() && _onSaved)
+                _onSaved();
 
-            fmt::print("\nWriting new files: ");
+            Events::LevelSaved(_result);
+        }
 
-            // Write level and metadata
-            auto levelData = SerializeToMemory([&level](StreamWriter& w) { return SaveLevel(level, w); });
-            writer.WriteEntry(level.FileName, levelData);
-            fmt::print("{}:{} ", level.FileName, levelData.size());
+    public:
+        SaveWorker() = default;
+        ~SaveWorker() { if (_thread.joinable()) _thread.join(); }
+        SaveWorker(const SaveWorker&) = delete;
+        SaveWorker(SaveWorker&&) = delete;
+        SaveWorker& operator=(const SaveWorker&) = delete;
+        SaveWorker& operator=(SaveWorker&&) = delete;
+
+        bool IsRunning() const { return _thread.joinable() && !_finished; }
+
+        void Start(filesystem::path path, bool autosave, std::function<void()> work,
+                   std::function<void()> onSaved = {}, std::function<void()> commit = {}) {
+            Wait(); // One save at a time
+            _result = { std::move(path), autosave, {} };
+            _commit = std::move(commit);
+            _onSaved = std::move(onSaved);
+            _finished = false;
+
+            _thread = std::thread([this, work = std::move(work)] {
+                try {
+                    work();
+                }
+                catch (const std::exception& e) {
+                    _result.Error = e.what();
+                }
 
-            auto levelMetadata = SerializeLevelMetadata(level);
-            writer.WriteEntry(metadataName, levelMetadata); // IED file
-            fmt::print("{}:{} ", metadataName, levelMetadata.size());
+                _finished = true;
+            });
+        }
 
-            if (level.IsVertigo() && !mission.ContainsFileType(".ham"))
-                AppendVertigoData(writer, path.stem().string() + ".ham");
+        // Blocks until the current save finishes and publishes the result
+        void Wait() {
+            if (!_thread.joinable()) return;
+            _thread.join();
+            Publish();
+        }
 
-            if (Resources::CustomResources.Any()) {
-                if (mission.IsDescent1()) {
-                    auto dtx = SerializeToMemory([](StreamWriter& w) {
-                        return Resources::CustomResources.WriteDtx(w, Resources::GetPalette());
-                    });
-                    writer.WriteEntry(baseName + ".dtx", dtx);
-                    fmt::print("{}:{} ", baseName + ".dtx", dtx.size());
-                }
-                else {
-                    auto pog = SerializeToMemory([](StreamWriter& w) {
-                        return Resources::CustomResources.WritePog(w, Resources::GetPalette());
-                    });
-                    writer.WriteEntry(baseName + ".pog", pog);
-                    fmt::print("{}:{} ", baseName + ".pog", pog.size());
-                }
-            }
+        // Publishes the result of a finished save. Call once per frame.
+        void Update() {
+            if (_finished) Wait();
+        }
+    };
+
+    SaveWorker BackgroundSave;
+
+    // Blocks until a running save finishes and publishes its result
+    void FinishBackgroundSave() {
+        BackgroundSave.Wait();
+    }
+
+    // Writes a level snapshot to a temporary hog next to the path. Finish with ReplaceHog().
+    void WriteHogFiles(LevelSnapshot& snapshot, HogFile& mission, const filesystem::path& path) {
+        auto& level = snapshot.SavedLevel;
+        if (level.FileName.empty())
+            throw Exception("Level filename is empty!");
+
+        auto baseName = String::NameWithoutExtension(level.FileName);
+        auto metadataName = baseName + "." + METADATA_EXTENSION;
+        HogUpdate update(mission);
+
+        // Skip files serialized later
+        for (auto ext : { ".dtx", ".pog", ".rl2", ".rdl", ".ied" })
+            update.Remove(baseName + ext);
+
+        fmt::print("Writing new files: ");
 
-            fmt::println("");
+        // Write level and metadata
+        auto levelData = SerializeToMemory([&level](StreamWriter& w) { return level.Serialize(w); });
+        fmt::print("{}:{} ", level.FileName, levelData.size());
+        update.WriteEntry(level.FileName, std::move(levelData));
+
+        auto levelMetadata = SerializeLevelMetadata(level, snapshot.Lighting);
+        fmt::print("{}:{} ", metadataName, levelMetadata.size());
+        update.WriteEntry(metadataName, std::move(levelMetadata)); // IED file
+
+        if (level.IsVertigo() && !mission.ContainsFileType(".ham"))
+            AppendVertigoData(update, path.stem().string() + ".ham");
+
+        if (!snapshot.Textures.empty()) {
+            auto textureName = baseName + (mission.IsDescent1() ? ".dtx" : ".pog");
+            fmt::print("{}:{} ", textureName, snapshot.Textures.size());
+            update.WriteEntry(textureName, std::move(snapshot.Textures));
+        }
+
+        fmt::println("");
+
+        // Unchanged entries are copied as-is
+        update.WriteTemporary(path);
+    }
+
+    // Moves a hog written by WriteHogFiles() over the path. The mission is unmapped if it is the file being replaced.
+    void ReplaceHog(HogFile* mission, const filesystem::path& path) {
+        bool replacing = mission && mission->Path == path && mission->IsMapped();
+        if (replacing) mission->Unmap();
+
+        try {
+            HogUpdate::Replace(path);
+        }
+        catch (...) {
+            if (replacing) mission->Map(); // The old file is still in place
+            throw;
+        }
+    }
+
+    // Writes a HOG file and updates the level. Returns false if the save failed.
+    bool WriteHog(Level& level, HogFile& mission, filesystem::path path) {
+        BackgroundSave.Wait();
+
+        try {
+            auto snapshot = TakeSnapshot(level, mission.IsDescent1());
+            WriteHogFiles(snapshot, mission, path);
+            ReplaceHog(&mission, path);
         }
         catch (const std::exception& e) {
             ShowErrorMessage(e);
             SPDLOG_ERROR(e.what());
-            return;
+            return false;
         }
 
-        BackupFile(path);
-        filesystem::remove(path); // Remove existing
-        filesystem::rename(tempPath, path); // Rename temp to destination
         fmt::print("\n");
+        return true;
+    }
+
+    // Writes a level to a hog on the save worker.
+    // The worker reads the entry table of the mission again so it doesn't share the HogFile with the main thread.
+    // The mission stays mapped while the worker runs. The result is only moved into place on the main thread,
+    // so reads through Game::Mission never see the new file with the old entry offsets.
+    void WriteHogAsync(Level& level, HogFile& mission, const filesystem::path& path, bool autosave, std::function<void()> onSaved = {}) {
+        BackgroundSave.Wait(); // Finish the previous save before the mission can be reloaded
+        auto snapshot = MakeRef<LevelSnapshot>(TakeSnapshot(level, mission.IsDescent1()));
+        auto missionPath = mission.Path;
+
+        BackgroundSave.Start(path, autosave, [snapshot, missionPath, path] {
+            auto source = HogFile::Read(missionPath);
+            WriteHogFiles(*snapshot, source, path);
+        }, std::move(onSaved), [path] {
+            ReplaceHog(Game::Mission ? &*Game::Mission : nullptr, path);
+        });
+    }
+
+    // Writes the level, metadata and custom textures of a standalone level
+    void WriteLevelFiles(LevelSnapshot& snapshot, const filesystem::path& path) {
+        auto& level = snapshot.SavedLevel;
+        auto levelData = SerializeToMemory([&level](StreamWriter& w) { return level.Serialize(w); });
+        File::WriteAllBytesAtomic(path, levelData, ".bak");
+
+        filesystem::path metadataPath = path;
+        metadataPath.replace_extension(METADATA_EXTENSION);
+        File::WriteAllBytesAtomic(metadataPath, SerializeLevelMetadata(level, snapshot.Lighting));
+
+        if (!snapshot.Textures.empty()) {
+            filesystem::path texPath = path;
+            texPath.replace_extension(level.IsDescent1() ? ".dtx" : ".pog");
+            File::WriteAllBytesAtomic(texPath, snapshot.Textures);
+        }
+    }
+
+    // Saves a level to the file system on the save worker.
+    // The level takes the new path and is marked clean only once the files are written.
+    void SaveLevelToPath(Level& level, std::filesystem::path path, bool autosave = false, std::function<void()> onSaved = {}) {
+        BackgroundSave.Wait();
+        CleanLevel(level);
+        level.CameraPosition = Render::Camera.Position;
+        level.CameraTarget = Render::Camera.Target;
+        level.CameraUp = Render::Camera.Up;
+        auto snapshot = MakeRef<LevelSnapshot>(TakeSnapshot(level, level.IsDescent1()));
+
+        if (!autosave) {
+            onSaved = [&level, path, cleanId = History.GetDataSnapshotId(), onSaved = std::move(onSaved)] {
+                level.Path = path;
+                level.FileName = path.filename().string();
+                History.SetCleanSnapshot(cleanId); // Also updates the window title
+                if (onSaved) onSaved();
+            };
+        }
+
+        BackgroundSave.Start(path, autosave, [snapshot, path] {
+            WriteLevelFiles(*snapshot, path);
+        }, std::move(onSaved));
     }
 
     void LoadFile(const filesystem::path& path) {
+        FinishBackgroundSave();
+
         try {
             auto version = FileVersionFromHeader(path);
             if (version > 0 && version <= 8) {
@@ -284,6 +405,8 @@ namespace Inferno::Editor {
     }
 
     void LoadLevelFromHOG(string name) {
+        FinishBackgroundSave();
+
         try {
             auto level = Resources::ReadLevel(name);
             level.FileName = name;
@@ -305,6 +428,8 @@ namespace Inferno::Editor {
     void OnSave();
 
     void NewLevel(string name, string fileName, int16 version, bool addToHog) {
+        FinishBackgroundSave();
+
         if (!addToHog)
             Game::UnloadMission();
 
@@ -340,7 +465,7 @@ namespace Inferno::Editor {
         filesystem::copy(path, backupPath, filesystem::copy_options::overwrite_existing);
     }
 
-    void SaveUnpackagedLevel(Level& level, const filesystem::path& path) {
+    void SaveUnpackagedLevel(Level& level, const filesystem::path& path, std::function<void()> onSaved = {}) {
         filesystem::path folder = path;
         folder.remove_filename();
         string newFileName = String::NameWithoutExtension(path.filename().string());
@@ -364,7 +489,7 @@ namespace Inferno::Editor {
         }
 
         // Save level after copying files in case any have changed since the last save
-        SaveLevelToPath(level, path);
+        SaveLevelToPath(level, path, false, std::move(onSaved));
     }
 
     void OnSaveAs() {
@@ -398,7 +523,7 @@ namespace Inferno::Editor {
         if (ExtensionEquals(*path, L"hog")) {
             if (Game::Mission) {
                 // Update level in existing hog
-                WriteHog(level, *Game::Mission, *path);
+                if (!WriteHog(level, *Game::Mission, *path)) return;
                 auto srcMsn = Game::Mission->GetMissionPath(); // get the msn path before reloading
                 Game::LoadMission(*path);
 
@@ -412,7 +537,7 @@ namespace Inferno::Editor {
             else {
                 // Create a new hog
                 HogFile hog{}; // empty
-                WriteHog(level, hog, *path);
+                if (!WriteHog(level, hog, *path)) return;
                 Game::LoadMission(*path);
                 Events::ShowDialog(DialogType::HogEditor);
             }
@@ -420,8 +545,13 @@ namespace Inferno::Editor {
         }
         else {
             path->replace_extension(ext);
-            SaveUnpackagedLevel(level, *path);
-            Game::UnloadMission();
+
+            // The level is marked clean once the files are written
+            SaveUnpackagedLevel(level, *path, [path = *path] {
+                Game::UnloadMission();
+                Settings::Editor.AddRecentFile(path);
+            });
+            return;
         }
 
         Settings::Editor.AddRecentFile(*path);
@@ -434,10 +564,13 @@ namespace Inferno::Editor {
 
         if (Game::Mission) {
             assert(level.FileName != "");
-            WriteHog(level, *Game::Mission, Game::Mission->Path);
-            Game::LoadMission(Game::Mission->Path);
-            SetStatusMessage(L"Mission saved to {}", Game::Mission->Path.filename().wstring());
-            Settings::Editor.AddRecentFile(Game::Mission->Path);
+            auto path = Game::Mission->Path;
+
+            WriteHogAsync(level, *Game::Mission, path, false, [path, cleanId = History.GetDataSnapshotId()] {
+                Game::LoadMission(path); // Reload
+                Settings::Editor.AddRecentFile(path);
+                History.SetCleanSnapshot(cleanId);
+            });
         }
         else {
             // standalone level
@@ -445,12 +578,10 @@ namespace Inferno::Editor {
                 OnSaveAs();
             }
             else {
-                SaveLevelToPath(level, level.Path);
-                Settings::Editor.AddRecentFile(level.Path);
+                auto path = level.Path;
+                SaveLevelToPath(level, path, false, [path] { Settings::Editor.AddRecentFile(path); });
             }
         }
-
-        History.UpdateCleanSnapshot();
     }
 
     bool CanConvertToD2() { return !Game::Level.IsDescent2NoVertigo(); }
@@ -515,15 +646,12 @@ namespace Inferno::Editor {
                 if (Seq::contains(skippedExtensions, ext))
                     continue; // skip custom textures and the level as they are written after
 
-                if (String::InvariantEquals(entry.NameWithoutExtension(), baseName)) {
-                    auto data = mission->ReadEntry(entry);
-                    writer.WriteEntry("_test" + entry.Extension(), data);
-                }
+                if (String::InvariantEquals(entry.NameWithoutExtension(), baseName))
+                    writer.CopyEntry(*mission, entry, "_test" + entry.Extension());
 
                 // Copy HAM if present
                 if (entry.IsHam() && String::InvariantEquals(entry.NameWithoutExtension(), missionFileName)) {
-                    auto data = mission->ReadEntry(entry);
-                    writer.WriteEntry("_test.ham", data);
+                    writer.CopyEntry(*mission, entry, "_test.ham");
                     wroteHam = true;
                 }
             }
@@ -563,7 +691,9 @@ namespace Inferno::Editor {
     }
 
     void CheckForAutosave() {
-        if (Game::ElapsedTime > _nextAutosave) {
+        BackgroundSave.Update();
+
+        if (Game::ElapsedTime > _nextAutosave && !BackgroundSave.IsRunning()) {
             try {
                 auto& path = Game::Mission ? Game::Mission->Path : Game::Level.Path;
                 if (path.empty()) path = Game::Level.FileName;
@@ -571,7 +701,7 @@ namespace Inferno::Editor {
                 SPDLOG_INFO(L"Autosaving backup to {}", backupPath);
 
                 if (Game::Mission) {
-                    WriteHog(Game::Level, *Game::Mission, backupPath);
+                    WriteHogAsync(Game::Level, *Game::Mission, backupPath, true);
                 }
                 else {
                     SaveLevelToPath(Game::Level, backupPath, true);
@@ -7,14 +7,26 @@
 #include "Editor.h"
 #include "ScopedTimer.h"
 #include "WindowsDialogs.h"
+#include "TriangleBvh.h"
+#include "Parallel.h"
+#include "TextureCache.h"
+#include "SegmentVisibility.h"
 
 namespace Inferno::Editor {
+    // Lighting of a finished pass during a progressive bake
+    struct LightPreview {
+        List<SideLighting> Sides; // Indexed by segment * 6 + side
+        List<Color> VolumeLight; // Indexed by segment
+    };
+
     namespace {
         std::thread LightWorkerThread;
         inline Option<Level> LightLevelResults; // New level lighting
+        TripleBuffer<LightPreview> LightPreviews; // Written by the light worker, shown by the editor
     }
 
     constexpr float PLANE_TOLERANCE = -0.01f;
+    constexpr float PREVIEW_MIN_BOUNCE_LIGHT = 0.05f; // Dimmer sides don't bounce light in preview bakes
 
     // Scales a color down to a max brightness while retaining color
     constexpr void ScaleColor(Color& color, float maxValue) {
@@ -75,6 +87,8 @@ namespace Inferno::Editor {
         bool EnableOcclusion = true;
         float DynamicMultiplier = 1; // To reduce the intensity of flickering lights
 
+        bool operator==(const LightSource&) const = default;
+
         Color MaxBrightness() const {
             Color max;
             for (auto& c : Colors)
@@ -83,23 +97,31 @@ namespace Inferno::Editor {
         }
     };
 
+    constexpr int32 GetSideIndex(Tag tag) {
+        return (int32)tag.Segment * 6 + (int32)tag.Side;
+    }
+
+    // Light received by a side. Index is segment * 6 + side.
+    struct SideLight {
+        int32 Index = 0;
+        SideLighting Light;
+
+        Tag GetTag() const { return { SegID(Index / 6), SideID(Index % 6) }; }
+    };
+
     // light info during ray casting
     struct LightRayCast {
-        Dictionary<Tag, SideLighting> Accumulated; // Accumulated light for all passes
-        Dictionary<Tag, SideLighting> Pass; // Light for this pass, cleared after each iteration
+        List<SideLight> Accumulated; // Accumulated light for all passes. Sorted by index.
+        List<SideLight> Pass; // Light for the last pass. Sorted by index.
         // Maximum value of light in the pass.
         // This prevents faces adjacent to a light source exceeding the source brightness.
         Color PassMaxValue;
         const LightSource* Source = nullptr;
 
-        void AddLight(Tag tag, const Color& light, int16 point) {
-            Pass[tag][point] += light;
-        }
-
         void UpdateMaxValueFromPass(float reflectance) {
             Color max;
-            for (auto& colors : Pass | views::values)
-                for (auto& color : colors)
+            for (auto& side : Pass)
+                for (auto& color : side.Light)
                     if (max.ToVector3().Length() < color.ToVector3().Length())
                         max = color;
 
@@ -108,42 +130,197 @@ namespace Inferno::Editor {
 
         // Accumulates lighting from the pass
         void AccumulatePass(bool keep = true) {
-            for (auto& [dest, target] : Pass) {
-                for (auto& light : target)
+            for (auto& side : Pass)
+                for (auto& light : side.Light)
                     ClampColor(light, { 0, 0, 0, 0 }, PassMaxValue);
 
-                auto& light = Accumulated[dest]; // will create in place if missing
+            // Both lists are sorted, so they can be merged in a single pass
+            List<SideLight> merged;
+            merged.reserve(Accumulated.size() + Pass.size());
+            size_t a = 0;
+
+            for (auto& target : Pass) {
+                while (a < Accumulated.size() && Accumulated[a].Index < target.Index)
+                    merged.push_back(Accumulated[a++]);
+
+                // Sides lit by a pass are always added, even if the pass isn't kept
+                SideLight light = { target.Index };
+                if (a < Accumulated.size() && Accumulated[a].Index == target.Index)
+                    light = Accumulated[a++];
 
                 if (keep) {
                     for (int i = 0; i < 4; i++)
-                        light[i] += target[i]; // change to assignment instead of sum to view the final pass contribution
+                        light.Light[i] += target.Light[i]; // change to assignment instead of sum to view the final pass contribution
                 }
+
+                merged.push_back(light);
             }
+
+            merged.insert(merged.end(), Accumulated.begin() + a, Accumulated.end());
+            Accumulated = std::move(merged);
         }
     };
 
-    // Self-contained unit of work
-    struct LightContext {
-        Dictionary<Tag, LightRayCast> RayCasts;
+    // Light received by each side of the level during a pass. Stored densely so adding light doesn't hash or allocate.
+    // Only the touched sides are visited when the pass is taken, so resetting the buffer is proportional to them.
+    class LightPassBuffer {
+        List<SideLighting> _sides; // Indexed by segment * 6 + side
+        List<uint8> _isTouched;
+        List<int32> _touched;
+
+    public:
+        void Resize(size_t segments) {
+            _sides.assign(segments * 6, {});
+            _isTouched.assign(segments * 6, false);
+            _touched.clear();
+        }
 
-        // Key is a combination of src seg, src vertex and dest vertex. Value indicates if dest is visible.
-        Dictionary<int64, bool> HitTests;
+        void Add(Tag tag, int point, const Color& light) {
+            auto index = GetSideIndex(tag);
+            if (!_isTouched[index]) {
+                _isTouched[index] = true;
+                _touched.push_back(index);
+            }
 
-        List<LightSource> Lights;
+            _sides[index][point] += light;
+        }
+
+        // Returns the lit sides sorted by index and resets the buffer
+        List<SideLight> Take() {
+            Seq::sort(_touched);
+
+            List<SideLight> pass;
+            pass.reserve(_touched.size());
+
+            for (auto index : _touched) {
+                pass.push_back({ index, _sides[index] });
+                _sides[index] = {};
+                _isTouched[index] = false;
+            }
+
+            _touched.clear();
+            return pass;
+        }
+    };
+
+    // Open addressing hash table of occlusion results between two side points.
+    // Each entry is two packed integers, so a result only takes 16 bytes and lookups don't allocate.
+    class VisibilityTable {
+    public:
+        struct Key {
+            uint64 Src = 0, Dest = 0; // Segment, side and point packed by MakeKey
+        };
+
+    private:
+        static constexpr uint64 BLOCKED_BIT = 1ull << 63; // Stored in the high bit of Dest
+
+        List<Key> _entries; // An entry with a Src of zero is empty
+        size_t _count = 0;
+
+        static size_t Hash(const Key& key) {
+            auto hash = key.Src * 0x9e3779b97f4a7c15ull ^ key.Dest;
+            hash ^= hash >> 29;
+            hash *= 0xbf58476d1ce4e5b9ull;
+            hash ^= hash >> 32;
+            return hash;
+        }
+
+        // Returns the slot containing the key, or the empty slot where it would be inserted
+        size_t FindSlot(const Key& key) const {
+            auto mask = _entries.size() - 1;
+            for (auto i = Hash(key) & mask;; i = (i + 1) & mask) {
+                auto& entry = _entries[i];
+                if (entry.Src == 0 || (entry.Src == key.Src && (entry.Dest & ~BLOCKED_BIT) == key.Dest))
+                    return i;
+            }
+        }
+
+        void Rehash(size_t capacity) {
+            auto entries = std::move(_entries);
+            _entries.assign(capacity, {});
+
+            for (auto& entry : entries) {
+                if (entry.Src != 0)
+                    _entries[FindSlot({ entry.Src, entry.Dest & ~BLOCKED_BIT })] = entry;
+            }
+        }
+
+    public:
+        static Key MakeKey(Tag src, int srcPoint, Tag dest, int destPoint) {
+            auto pack = [](Tag tag, int point) {
+                return ((uint64)(uint32)tag.Segment << 5 | (uint64)tag.Side << 2 | (uint64)point) + 1;
+            };
+
+            return { pack(src, srcPoint), pack(dest, destPoint) };
+        }
+
+        static SegID GetSourceSegment(const Key& key) { return SegID((key.Src - 1) >> 5); }
+        static SegID GetDestSegment(const Key& key) { return SegID(((key.Dest & ~BLOCKED_BIT) - 1) >> 5); }
+
+        // Returns true if the path was blocked, or nothing if the key isn't in the table
+        Option<bool> Find(const Key& key) const {
+            if (_entries.empty()) return {};
+            auto& entry = _entries[FindSlot(key)];
+            if (entry.Src == 0) return {};
+            return (entry.Dest & BLOCKED_BIT) != 0;
+        }
+
+        void Insert(const Key& key, bool blocked) {
+            if ((_count + 1) * 2 > _entries.size())
+                Rehash(std::max(_entries.size() * 2, (size_t)1024)); // Keep the load under half
+
+            auto& entry = _entries[FindSlot(key)];
+            if (entry.Src == 0) _count++;
+            entry = { key.Src, key.Dest | (blocked ? BLOCKED_BIT : 0) };
+        }
+
+        void Merge(const VisibilityTable& other) {
+            for (auto& entry : other._entries) {
+                if (entry.Src != 0)
+                    Insert({ entry.Src, entry.Dest & ~BLOCKED_BIT }, entry.Dest & BLOCKED_BIT);
+            }
+        }
+
+        // Removes every entry the predicate returns true for
+        template<class Fn>
+        void RemoveIf(Fn&& predicate) {
+            for (auto& entry : _entries) {
+                if (entry.Src != 0 && predicate(Key{ entry.Src, entry.Dest & ~BLOCKED_BIT })) {
+                    entry = {};
+                    _count--;
+                }
+            }
+
+            Rehash(_entries.size()); // Removing entries breaks probe sequences, so reinsert the rest
+        }
+
+        void Clear() {
+            _entries = {};
+            _count = 0;
+        }
+
+        size_t Size() const { return _count; }
+    };
+
+    // State owned by a single worker thread
+    struct LightContext {
+        const VisibilityTable* SharedVisibility = nullptr; // Results from previous bakes. Read only while baking.
+        const SegmentVisibility* VisibleSegments = nullptr; // Shared by all threads
+        VisibilityTable Visibility; // Results cast by this thread during the bake
+
+        LightPassBuffer Pass; // Light from the pass being cast
         LightSettings Settings;
-        std::thread Thread;
+        const TriangleBvh* Occluders = nullptr; // Shared by all threads
         int CastStats = 0;
         int HitStats = 0;
         uint64 CacheHits = 0;
-        int Id = 0;
-
-        LightContext() {
-            HitTests.reserve(100'000);
-            RayCasts.reserve(50);
-        }
+        int Tasks = 0;
+    };
 
-        // Initial lighting pass from direct light sources
-        void EmitDirectLight(Level& level);
+    // One pass of a light. Passes of a light must run in order, so each task queues the next pass when it finishes.
+    struct LightTask {
+        LightRayCast* Cast = nullptr;
+        int Pass = 0; // 0 is direct light, bounces start at 1
     };
 
     // checks that there's enough light to bother saving. Prevents wasteful raycasts.
@@ -297,8 +474,8 @@ namespace Inferno::Editor {
     }
 
     // Returns segments that are within range and visible from the source surface.
-    // Culls segments that are behind the plane of src.
-    Set<SegID> GetSegmentsInRange(Level& level, Tag src, float distanceThreshold) {
+    // Culls segments that are behind the plane of src or not in the potentially visible set of its segment.
+    Set<SegID> GetSegmentsInRange(Level& level, Tag src, float distanceThreshold, const SegmentVisibility* visible = nullptr) {
         auto srcFace = Face::FromSide(level, src);
 
         Set<SegID> segmentsToLight;
@@ -317,6 +494,7 @@ namespace Inferno::Editor {
                 if (!LightPassesThroughSide(level, seg, sideId)) continue;
                 auto connection = seg.GetConnection(sideId);
                 if (segmentsToLight.contains(connection)) continue; // Don't add visited connections
+                if (visible && !visible->CanSee(src.Segment, connection)) continue; // Every ray into it would be occluded
 
                 if (src.Segment == segId) {
                     // always search valid connections from source (fix for zero volume segments)
@@ -351,51 +529,47 @@ namespace Inferno::Editor {
         return segmentsToLight;
     }
 
-    // Returns true if the ray intersects any faces of the segment
-    bool HitTestRay(Level& level, const Set<SegID>& segments, const Ray& ray, float minDist, LightContext& ctx) {
-        for (auto& segId : segments) {
-            const auto& seg = level.GetSegment(segId);
+    // Creates a BVH of the sides that block light. One-way walls only block light entering their front.
+    TriangleBvh CreateOccluderBvh(Level& level) {
+        List<TriangleBvh::Triangle> triangles;
+        auto& cache = level.Collision;
+        cache.Update(level);
+
+        for (int segId = 0; segId < level.Segments.size(); segId++) {
+            auto& seg = level.Segments[segId];
 
             for (auto& sideId : SideIDs) {
                 if (LightPassesThroughSide(level, seg, sideId)) continue; // ignore sides that light passes through
-                const auto& side = seg.GetSide(sideId);
-                bool sideIsWall = side.Wall != WallID::None;
-                if (sideIsWall && side.Normals[0].Dot(ray.direction) > 0) continue; // skip walls pointing the same direction (allows passing through one-way walls)
-
-                auto ri = side.GetRenderIndices();
-                auto indices = seg.GetVertexIndices(sideId);
-                float dist{};
-
-                ctx.CastStats++;
-                if (ray.Intersects(level.Vertices[indices[ri[0]]],
-                                   level.Vertices[indices[ri[1]]],
-                                   level.Vertices[indices[ri[2]]],
-                                   dist)
-                    && dist < minDist) {
-                    ctx.HitStats++;
-                    return true;
-                }
-
-                ctx.CastStats++;
-                if (ray.Intersects(level.Vertices[indices[ri[3]]],
-                                   level.Vertices[indices[ri[4]]],
-                                   level.Vertices[indices[ri[5]]],
-                                   dist)
-                    && dist < minDist) {
-                    ctx.HitStats++;
-                    return true;
+                auto index = CollisionCache::SideIndex(SegID(segId), sideId);
+
+                for (int tri = index * 2; tri < index * 2 + 2; tri++) {
+                    triangles.push_back({
+                        .V0 = cache.V0(tri),
+                        .V1 = cache.V1(tri),
+                        .V2 = cache.V2(tri),
+                        .Normal = cache.Normal(index * 2),
+                        .OneSided = cache.HasWall(index) // allows passing through one-way walls
+                    });
                 }
             }
         }
 
+        return TriangleBvh(std::move(triangles));
+    }
+
+    // Returns true if the ray intersects any light blocking geometry before minDist
+    bool HitTestRay(const Ray& ray, float minDist, LightContext& ctx) {
+        if (ctx.Occluders->AnyHit(ray, minDist, ctx.CastStats)) {
+            ctx.HitStats++;
+            return true;
+        }
+
         return false;
     }
 
     // Returns true if geometry blocks the path between src point and light. Caches results.
-    bool HitTest(Level& level,
-                 const Set<SegID>& segments,
-                 PointID destPoint,
-                 PointID lightPoint,
+    bool HitTest(int destIndex,
+                 int lightIndex,
                  const Vector3& lightPos,
                  const Vector3& samplePos,
                  Tag src,
@@ -403,35 +577,27 @@ namespace Inferno::Editor {
                  LightContext& ctx) {
         if (src.Segment == dest.Segment) return false;
 
-        if ((int)src.Segment > 32767 || (int)dest.Segment > 32767 || (int)destPoint > 46339 || (int)lightPoint > 46339)
-            throw Exception("Lighting only supports up to 32767 segments and 46339 verts");
+        // The sample positions only depend on the source and dest faces, so the side points identify the ray
+        auto key = VisibilityTable::MakeKey(src, lightIndex, dest, destIndex);
 
-        auto packedSegId = SzudzikPairing((uint16)src.Segment, (uint16)dest.Segment); // limited to 32767 (28 bit result)
-        auto packedPointId = SzudzikPairing(destPoint, lightPoint); // limited to 46339 (30 bit result)
-        uint64 id = (uint64)dest.Side << (28 + 30 + 3) | (uint64)src.Side << (28 + 30) | (uint64)packedPointId << 28 | (uint64)packedSegId;
+        auto cached = ctx.SharedVisibility ? ctx.SharedVisibility->Find(key) : Option<bool>();
+        if (!cached) cached = ctx.Visibility.Find(key);
 
-        //// Note that this packing breaks if there are more than 8191 segments in a level
-        //uint16 packedSrc = (uint16)src.Segment | ((uint16)src.Side << (16 - 3)); // pack side into the 3 high bits
-        //uint16 packedDest = (uint16)dest.Segment | ((uint16)dest.Side << (16 - 3)); // pack side into the 3 high bits
-        //uint64 id = (uint64)packedDest << 48 | (uint64)packedSrc << 32 | (uint64)destPoint << 16 | lightPoint;
+        if (cached) {
+            ctx.CacheHits++;
+            return *cached;
+        }
 
-        if (!ctx.HitTests.contains(id)) {
-            auto dir = samplePos - lightPos;
-            float minDist = dir.Length() - 0.01f; // minimum distance the light must travel. hitting something before this means a wall was in the way.
-            dir.Normalize();
+        auto dir = samplePos - lightPos;
+        float minDist = dir.Length() - 0.01f; // minimum distance the light must travel. hitting something before this means a wall was in the way.
+        dir.Normalize();
 
-            bool result = false;
-            // Direction length can be zero if segment has zero volume, assume it misses
-            Ray ray(lightPos, dir);
-            result = dir.Length() != 0 ? HitTestRay(level, segments, ray, minDist, ctx) : false;
+        // Direction length can be zero if segment has zero volume, assume it misses
+        Ray ray(lightPos, dir);
+        bool result = dir.Length() != 0 ? HitTestRay(ray, minDist, ctx) : false;
 
-            ctx.HitTests[id] = result;
-            return result;
-        }
-        else {
-            ctx.CacheHits++;
-            return ctx.HitTests[id];
-        }
+        ctx.Visibility.Insert(key, result);
+        return result;
     }
 
     void LightSegments(Level& level,
@@ -482,7 +648,7 @@ namespace Inferno::Editor {
                         if (attenuation <= 0) return Color();
 
                         if (cast.Source->EnableOcclusion &&
-                            HitTest(level, segmentsToLight, destVertIds[vertIndex], lightVertIds[lightIndex], lightSamples[lightIndex], destSamples[vertIndex], src, dest, ctx))
+                            HitTest(vertIndex, lightIndex, lightSamples[lightIndex], destSamples[vertIndex], src, dest, ctx))
                             return Color();
 
                         auto multiplier = bouncePass ? ctx.Settings.Reflectance : ctx.Settings.Multiplier;
@@ -507,7 +673,7 @@ namespace Inferno::Editor {
                             if (!checkPlanes(vertIndex, vertIndex)) continue;
                             auto intensity = calcIntensity(vertIndex);
                             if (CheckMinLight(intensity))
-                                cast.Pass[dest][vertIndex] += intensity;
+                                ctx.Pass.Add(dest, vertIndex, intensity);
                         }
                     }
                     else {
@@ -541,7 +707,7 @@ namespace Inferno::Editor {
                             }
 
                             if (CheckMinLight(intensity))
-                                cast.Pass[dest][i] += intensity;
+                                ctx.Pass.Add(dest, i, intensity);
                         }
                     }
                 }
@@ -553,40 +719,50 @@ namespace Inferno::Editor {
         cast.UpdateMaxValueFromPass(ctx.Settings.Reflectance);
 
         // Use the previous pass targets as the light sources
-        Dictionary<Tag, SideLighting> prevPass = std::move(cast.Pass);
-        cast.Pass = {};
+        List<SideLight> prevPass = std::move(cast.Pass);
 
-        for (const auto& [src, lightColors] : prevPass) {
+        for (const auto& target : prevPass) {
             if (RequestCancelLighting) break;
+            auto src = target.GetTag();
             auto [srcSeg, srcSide] = level.GetSegmentAndSide(src);
 
             // don't emit from open connections (from accurate volumes setting)
             if (srcSeg.SideHasConnection(src.Side) && !srcSeg.SideIsWall(src.Side)) continue;
 
-            Set<SegID> segmentsToLight = GetSegmentsInRange(level, src, ctx.Settings.DistanceThreshold);
+            if (ctx.Settings.Preview) {
+                Color total;
+                for (auto& c : target.Light) total += c;
+                if (total.x + total.y + total.z < PREVIEW_MIN_BOUNCE_LIGHT) continue;
+            }
+
+            auto visible = cast.Source->EnableOcclusion ? ctx.VisibleSegments : nullptr;
+            Set<SegID> segmentsToLight = GetSegmentsInRange(level, src, ctx.Settings.DistanceThreshold, visible);
             Color tmapColor = Resources::GetTextureInfo(srcSide.TMap).AverageColor;
             tmapColor.AdjustSaturation(2); // boost saturation to look nicer
             ScaleColor2(tmapColor, 1); // 100% brightness
-            SideLighting adjColors = lightColors;
+            SideLighting adjColors = target.Light;
             for (auto& c : adjColors)
                 c *= tmapColor; // premultiply the texture color into the light color
 
             LightSegments(level, adjColors, segmentsToLight, src, true, cast, ctx);
         }
 
+        cast.Pass = ctx.Pass.Take();
         return cast;
     }
 
-    LightRayCast& CastDirectLight(Level& level, const LightSource& light, const LightSettings& settings, LightContext& ctx) {
-        Set<SegID> segmentsToLight = GetSegmentsInRange(level, light.Tag, settings.DistanceThreshold);
+    LightRayCast& CastDirectLight(Level& level, LightRayCast& cast, LightContext& ctx) {
+        auto& light = *cast.Source;
+        auto& settings = ctx.Settings;
+        auto visible = light.EnableOcclusion ? ctx.VisibleSegments : nullptr;
+        Set<SegID> segmentsToLight = GetSegmentsInRange(level, light.Tag, settings.DistanceThreshold, visible);
 
-        auto& cast = ctx.RayCasts[light.Tag];
-        cast.Source = &light;
         cast.PassMaxValue = light.MaxBrightness() * settings.Multiplier;
         // Clamp to the max light value setting
         ClampColor(cast.PassMaxValue, Color(0, 0, 0), Color(settings.MaxValue, settings.MaxValue, settings.MaxValue));
 
         LightSegments(level, light.Colors, segmentsToLight, light.Tag, false, cast, ctx);
+        cast.Pass = ctx.Pass.Take();
         return cast;
     }
 
@@ -668,14 +844,6 @@ namespace Inferno::Editor {
         return sources;
     }
 
-    void LightContext::EmitDirectLight(Level& level) {
-        for (auto& source : Lights) {
-            if (RequestCancelLighting) return;
-            auto& cast = CastDirectLight(level, source, Settings, *this);
-            cast.AccumulatePass();
-        }
-    }
-
     // Calculates the volume light for all segments in the level based on surface lighting
     void SetVolumeLight(Level& level, bool accurateVolumes) {
         for (auto& seg : level.Segments) {
@@ -724,8 +892,8 @@ namespace Inferno::Editor {
     }
 
     // Generates the dynamic light table for destroyable and flickering lights
-    void SetDynamicLights(Level& level, const Dictionary<Tag, LightRayCast>& rayCasts) {
-        for (auto& [src, light] : rayCasts) {
+    void SetDynamicLights(Level& level, span<const LightRayCast> rayCasts) {
+        for (auto& light : rayCasts) {
             if (!light.Source->IsDynamic) continue;
 
             if (level.LightDeltaIndices.size() >= MaxDynamicLights) {
@@ -745,7 +913,7 @@ namespace Inferno::Editor {
                 Tag Tag;
                 SideLighting Lighting;
             };
-            auto accumulated = Seq::map(light.Accumulated, [](auto x) { return Accumulated{ x.first, x.second }; });
+            auto accumulated = Seq::map(light.Accumulated, [](auto& x) { return Accumulated{ x.GetTag(), x.Light }; });
             Seq::sortBy(accumulated, [](auto& a, auto& b) { return AverageBrightness(a.Lighting) > AverageBrightness(b.Lighting); });
 
             uint8 deltaCount = 0;
@@ -768,101 +936,350 @@ namespace Inferno::Editor {
             }
 
             level.LightDeltaIndices.push_back(LightDeltaIndex{
-                .Tag = src,
+                .Tag = light.Source->Tag,
                 .Count = deltaCount,
                 .Index = startIndex
             });
         }
     }
 
-    // Copies accumulated light to the level faces
-    void SetSideLighting(Level& level, const Dictionary<Tag, LightRayCast>& rayCasts, Color max, bool color) {
-        for (const auto& light : rayCasts | views::values) {
-            for (auto& [dest, l] : light.Accumulated) {
-                auto& side = level.GetSide(dest);
-                for (int vert = 0; vert < 4; vert++) {
-                    if (side.LockLight[vert]) continue;
-                    side.Light[vert] += l[vert];
-                    if (!color)
-                        ClampColor(side.Light[vert], { 0, 0, 0, 1 }, max); // clamp accumulated values to max
+    // Copies accumulated light to the level faces. Each thread handles a range of segments and adds the lights
+    // in the same order as a serial merge, so the result doesn't depend on the thread count.
+    void SetSideLighting(Level& level, span<const LightRayCast> rayCasts, Color max, bool color) {
+        ParallelFor(level.Segments.size(), 256, [&](size_t begin, size_t end) {
+            auto first = int32(begin * 6), last = int32(end * 6);
+
+            for (auto& light : rayCasts) {
+                auto& accumulated = light.Accumulated;
+                auto it = std::lower_bound(accumulated.begin(), accumulated.end(), first,
+                                           [](const SideLight& side, int32 index) { return side.Index < index; });
+
+                for (; it != accumulated.end() && it->Index < last; ++it) {
+                    auto& side = level.GetSide(it->GetTag());
+                    for (int vert = 0; vert < 4; vert++) {
+                        if (side.LockLight[vert]) continue;
+                        side.Light[vert] += it->Light[vert];
+                        if (!color)
+                            ClampColor(side.Light[vert], { 0, 0, 0, 1 }, max); // clamp accumulated values to max
+                    }
                 }
             }
-        }
+        });
     }
 
     // Removes all color from results
-    void DesaturateAccumulated(Dictionary<Tag, LightRayCast>& rayCasts) {
-        for (auto& cast : rayCasts | views::values)
-            for (auto& side : cast.Accumulated | views::values)
-                for (auto& l : side)
-                    l.AdjustSaturation(0);
+    void DesaturateAccumulated(LightRayCast& cast) {
+        for (auto& side : cast.Accumulated)
+            for (auto& l : side.Light)
+                l.AdjustSaturation(0);
     }
 
-    struct OctreeLeaf {
-        List<LightSource> Lights;
-        Array<Ptr<OctreeLeaf>, 8> Children;
-        DirectX::BoundingBox Bounds;
-        int Depth = 0;
-        static constexpr int MAX_DEPTH = 10;
-
-        void AddChildren(Level& level, const List<LightSource>& lights, int bucketSize) {
-            Lights = lights;
-
-            if (Depth >= MAX_DEPTH)
-                return; // prevent stack overflow due to stacked lights
-
-            Array<Vector3, DirectX::BoundingBox::CORNER_COUNT> corners;
-            Bounds.GetCorners(corners.data());
-            Dictionary<Tag, bool> used;
-
-            for (int i = 0; i < 8; i++) {
-                auto center = (Bounds.Center + corners[i]) / 2;
-                Children[i] = MakePtr<OctreeLeaf>();
-                auto& child = *Children[i];
-                child.Depth = Depth + 1;
-                child.Bounds = { center, Vector3(Bounds.Extents) / 2 };
-
-                for (auto& l : lights) {
-                    if (used.contains(l.Tag)) continue;
-                    auto face = Face::FromSide(level, l.Tag);
-                    if (child.Bounds.Contains(face.Center())) {
-                        used[l.Tag] = true;
-                        child.Lights.push_back(l);
-                    }
-                }
+    // Interleaves the low 10 bits of a value with two zero bits between each bit
+    constexpr uint32 SpreadBits(uint32 x) {
+        x &= 0x3ff;
+        x = (x | (x << 16)) & 0x030000ff;
+        x = (x | (x << 8)) & 0x0300f00f;
+        x = (x | (x << 4)) & 0x030c30c3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
+    }
+
+    // Sorts lights along a Z-order curve so lights that are near each other in the list are also near each other in the level
+    void SortLightsSpatially(Level& level, List<LightSource>& lights) {
+        if (lights.empty()) return;
+
+        List<Vector3> centers;
+        Vector3 minBounds(FLT_MAX), maxBounds(-FLT_MAX);
+
+        for (auto& light : lights) {
+            auto center = Face::FromSide(level, light.Tag).Center();
+            minBounds = Vector3::Min(minBounds, center);
+            maxBounds = Vector3::Max(maxBounds, center);
+            centers.push_back(center);
+        }
+
+        auto extent = maxBounds - minBounds;
+        auto scale = 1023 / std::max({ extent.x, extent.y, extent.z, 1.0f });
+
+        List<std::pair<uint32, LightSource>> keyed;
+        keyed.reserve(lights.size());
+
+        for (size_t i = 0; i < lights.size(); i++) {
+            auto p = (centers[i] - minBounds) * scale;
+            auto key = SpreadBits((uint32)p.x) | SpreadBits((uint32)p.y) << 1 | SpreadBits((uint32)p.z) << 2;
+            keyed.push_back({ key, lights[i] });
+        }
+
+        std::stable_sort(keyed.begin(), keyed.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+        for (size_t i = 0; i < lights.size(); i++)
+            lights[i] = keyed[i].second;
+    }
+
+    // Hashes everything about a side that can change the light it emits, receives or blocks
+    uint64 HashSide(const Level& level, const Segment& seg, SideID sideId) {
+        uint64 hash = HashBytes({});
+        auto add = [&hash](const auto& value) {
+            hash = HashBytes({ (const ubyte*)&value, sizeof(value) }, hash);
+        };
+
+        auto& side = seg.GetSide(sideId);
+        for (auto index : seg.GetVertexIndices(sideId))
+            add(level.Vertices[index]);
+
+        add(seg.GetConnection(sideId));
+        add(side.Type);
+        add(side.TMap);
+        add(side.TMap2);
+        add(side.UVs);
+        add(side.LockLight);
+        add(side.EnableOcclusion);
+        add(side.LightOverride.value_or(Color(-1, -1, -1, -1)));
+        add(side.LightRadiusOverride.value_or(-1.0f));
+        add(side.LightPlaneOverride.value_or(-1.0f));
+        add(side.DynamicMultiplierOverride.value_or(-1.0f));
+
+        if (auto wall = level.TryGetWall(side.Wall)) {
+            add(wall->Type);
+            add(wall->BlocksLight.value_or(false));
+            add(wall->BlocksLight.has_value());
+        }
+
+        return hash;
+    }
 
-                if (child.Lights.size() > bucketSize)
-                    child.AddChildren(level, child.Lights, bucketSize);
+    struct LightingSnapshot {
+        List<uint64> SideHashes; // Indexed by segment * 6 + side
+        List<DirectX::BoundingSphere> SegmentBounds;
+    };
+
+    LightingSnapshot TakeLightingSnapshot(const Level& level) {
+        LightingSnapshot snapshot;
+        snapshot.SideHashes.resize(level.Segments.size() * 6);
+        snapshot.SegmentBounds.resize(level.Segments.size());
+
+        ParallelFor(level.Segments.size(), 256, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                auto& seg = level.Segments[i];
+                for (auto& sideId : SideIDs)
+                    snapshot.SideHashes[i * 6 + (int)sideId] = HashSide(level, seg, sideId);
+
+                float radius = 0;
+                for (auto index : seg.Indices)
+                    radius = std::max(radius, Vector3::Distance(seg.Center, level.Vertices[index]));
 
-                if (Children[i]->Lights.empty())
-                    Children[i].reset(); // Free the node if it doesn't contain anything
+                snapshot.SegmentBounds[i] = { seg.Center, radius };
+            }
+        });
+
+        return snapshot;
+    }
+
+    // Returns the old and new bounds of segments with a side that changed between two snapshots of the same level
+    List<DirectX::BoundingSphere> FindChangedSegments(const LightingSnapshot& before, const LightingSnapshot& after) {
+        assert(before.SegmentBounds.size() == after.SegmentBounds.size());
+        List<DirectX::BoundingSphere> changed;
+
+        for (size_t i = 0; i < after.SegmentBounds.size(); i++) {
+            for (size_t side = 0; side < 6; side++) {
+                if (before.SideHashes[i * 6 + side] != after.SideHashes[i * 6 + side]) {
+                    changed.push_back(before.SegmentBounds[i]);
+                    changed.push_back(after.SegmentBounds[i]);
+                    break;
+                }
             }
         }
+
+        return changed;
+    }
+
+    // Results of the last completed bake. Lets a relight only recast the lights near sides that changed.
+    struct LightBakeCache {
+        LightSettings Settings;
+        LightingSnapshot Snapshot;
+        List<LightSource> Lights;
+        List<LightRayCast> RayCasts; // Parallel to Lights
     };
 
-    // Groups lights together into an axis aligned octree, stopping once bucket size is reached
-    OctreeLeaf CreateLightOctree(Level& level, const List<LightSource>& lights, int bucketSize) {
-        Vector3 minBounds = { FLT_MAX, FLT_MAX, FLT_MAX };
-        Vector3 maxBounds = { FLT_MIN, FLT_MIN, FLT_MIN };
+    // Ray visibility results kept between bakes. Only depends on geometry, so changing light settings keeps them.
+    struct VisibilityCache {
+        LightingSnapshot Snapshot; // Geometry the results were cast against
+        VisibilityTable Results;
+        SegmentVisibility Segments{ LightPassesThroughSide }; // Segments each segment can see through sides light passes through
+    };
 
-        for (auto& light : lights) {
-            auto face = Face::FromSide(level, light.Tag);
-            minBounds = VectorMin(minBounds, face.Center());
-            maxBounds = VectorMax(maxBounds, face.Center());
+    namespace {
+        // Only accessed by the light worker, or while it isn't running
+        Option<LightBakeCache> LastBake;
+        VisibilityCache Visibility;
+        std::atomic DiscardBakeCaches = false; // A different level was loaded while the worker was running
+
+        // Large levels can cast more rays than are worth keeping. About 64 MB of table at the maximum load.
+        constexpr size_t MAX_CACHED_RAY_RESULTS = 2'000'000;
+
+        void ClearBakeCaches() {
+            LastBake = {};
+            Visibility.Snapshot = {};
+            Visibility.Results.Clear();
+            Visibility.Segments.Clear();
+        }
+    }
+
+    void ClearLightingCache() {
+        if (LightWorkerRunning) {
+            DiscardBakeCaches = true; // The worker clears them when it finishes
+            return;
+        }
+
+        if (LightWorkerThread.joinable()) LightWorkerThread.join();
+        ClearBakeCaches();
+    }
+
+    // Removes cached visibility for rays that could pass through geometry that changed since the results were cast
+    void UpdateVisibilityCache(VisibilityCache& cache, const Level& level, LightingSnapshot snapshot) {
+        auto& results = cache.Results;
+
+        if (cache.Snapshot.SegmentBounds.size() != snapshot.SegmentBounds.size()) {
+            results.Clear(); // Segment IDs no longer line up
+        }
+        else if (results.Size() > 0) {
+            auto changed = FindChangedSegments(cache.Snapshot, snapshot);
+            constexpr size_t MAX_CHANGED_SEGMENTS = 512; // Testing every result against a large edit is slower than recasting
+            constexpr float SAMPLE_PADDING = 5; // Sample points can be offset outside of their segment
+
+            if (changed.size() > MAX_CHANGED_SEGMENTS * 2) {
+                results.Clear();
+            }
+            else if (!changed.empty()) {
+                auto& bounds = cache.Snapshot.SegmentBounds;
+                auto before = results.Size();
+
+                // A ray stays within the capsule around the centers of its source and dest segments
+                results.RemoveIf([&](const VisibilityTable::Key& key) {
+                    auto& a = bounds[(int)VisibilityTable::GetSourceSegment(key)];
+                    auto& b = bounds[(int)VisibilityTable::GetDestSegment(key)];
+                    Vector3 start = a.Center, end = b.Center;
+                    auto radius = std::max(a.Radius, b.Radius) + SAMPLE_PADDING;
+
+                    return Seq::exists(changed, [&](const DirectX::BoundingSphere& segment) {
+                        Vector3 center = segment.Center;
+                        auto axis = end - start;
+                        auto t = std::clamp((center - start).Dot(axis) / std::max(axis.LengthSquared(), FLT_EPSILON), 0.0f, 1.0f);
+                        return Vector3::Distance(center, start + axis * t) <= radius + segment.Radius;
+                    });
+                });
+
+                SPDLOG_INFO("Invalidated {} of {} cached ray results", before - results.Size(), before);
+            }
+        }
+
+        cache.Snapshot = std::move(snapshot);
+        cache.Segments.Update(level);
+    }
+
+    // Returns the results of the last bake that are still valid for each light, or null if the light must be recast.
+    // A light is recast when it changed or when a changed segment is close enough to affect any of its passes.
+    List<const LightRayCast*> FindReusableRayCasts(const LightBakeCache& cache, Level& level, const LightingSnapshot& snapshot,
+                                                   span<const LightSource> lights, const LightSettings& settings) {
+        List<const LightRayCast*> reusable(lights.size());
+        if (cache.Settings != settings || cache.Snapshot.SegmentBounds.size() != snapshot.SegmentBounds.size())
+            return reusable;
+
+        // Check the old and new bounds of changed segments, so moving geometry away from a light also relights it
+        auto changed = FindChangedSegments(cache.Snapshot, snapshot);
+
+        float maxRadius = 0;
+        for (size_t i = 0; i < snapshot.SegmentBounds.size(); i++)
+            maxRadius = std::max({ maxRadius, snapshot.SegmentBounds[i].Radius, cache.Snapshot.SegmentBounds[i].Radius });
+
+        // Each pass can reach segments whose portals are within the distance threshold of its sources,
+        // plus the size of the segment behind the portal. Rays and their occluders stay inside this sphere.
+        auto bounces = std::clamp(settings.Bounces, 0, 10);
+        auto reach = (bounces + 1) * (settings.DistanceThreshold + maxRadius * 2);
+
+        Dictionary<Tag, size_t> previous;
+        for (size_t i = 0; i < cache.Lights.size(); i++)
+            previous[cache.Lights[i].Tag] = i;
+
+        for (size_t i = 0; i < lights.size(); i++) {
+            auto& light = lights[i];
+            auto prev = previous.find(light.Tag);
+            if (prev == previous.end() || cache.Lights[prev->second] != light) continue;
+
+            auto center = Face::FromSide(level, light.Tag).Center();
+            bool affected = Seq::exists(changed, [&](const DirectX::BoundingSphere& bounds) {
+                return Vector3::Distance(center, bounds.Center) <= reach + bounds.Radius;
+            });
+
+            if (!affected)
+                reusable[i] = &cache.RayCasts[prev->second];
+        }
+
+        return reusable;
+    }
+
+    // Returns the settings used by a bake. Previews trade quality for a shorter bake.
+    LightSettings GetBakeSettings(const LightSettings& settings) {
+        auto result = settings;
+
+        if (settings.Preview) {
+            result.Bounces = std::min(result.Bounces, 1);
+            result.AccurateVolumes = false;
+        }
+
+        return result;
+    }
+
+    // Replaces the level lighting with the ambient light plus the accumulated light of every light
+    void ComposeLighting(Level& level, span<const LightRayCast> rayCasts, const LightSettings& settings) {
+        level.LightDeltaIndices.clear();
+        level.LightDeltas.clear();
+        SetAmbientLight(level, settings.Ambient);
+
+        auto maxValue = std::clamp(settings.MaxValue, 0.0f, 1.0f);
+        const Color max = { maxValue, maxValue, maxValue, 1 };
+
+        SetSideLighting(level, rayCasts, max, settings.EnableColor);
+        SetDynamicLights(level, rayCasts);
+        SetVolumeLight(level, settings.AccurateVolumes);
+    }
+
+    // Lights a copy of the level with the passes finished so far and sends it to the editor
+    void PublishPreview(Level& level, span<const LightRayCast> rayCasts, span<const size_t> castLights, const LightSettings& settings) {
+        if (settings.EnableColor) {
+            ComposeLighting(level, rayCasts, settings);
+        }
+        else {
+            // Later passes are added to the accumulated light, so desaturate a copy
+            List<LightRayCast> desaturated(rayCasts.size());
+            for (size_t i = 0; i < rayCasts.size(); i++) {
+                desaturated[i].Accumulated = rayCasts[i].Accumulated;
+                desaturated[i].Source = rayCasts[i].Source;
+            }
+
+            for (auto i : castLights)
+                DesaturateAccumulated(desaturated[i]);
+
+            ComposeLighting(level, desaturated, settings);
         }
 
-        minBounds -= Vector3(10, 10, 10);
-        maxBounds += Vector3(10, 10, 10);
-        Vector3 center = (minBounds + maxBounds) / 2;
+        auto& preview = LightPreviews.Back();
+        preview.Sides.resize(level.Segments.size() * 6);
+        preview.VolumeLight.resize(level.Segments.size());
 
-        OctreeLeaf tree;
-        tree.Bounds = DirectX::BoundingBox(center, maxBounds - center);
-        tree.AddChildren(level, lights, bucketSize);
-        return tree;
+        for (size_t i = 0; i < level.Segments.size(); i++) {
+            auto& seg = level.Segments[i];
+            preview.VolumeLight[i] = seg.VolumeLight;
+            for (int side = 0; side < 6; side++)
+                preview.Sides[i * 6 + side] = seg.Sides[side].Light;
+        }
+
+        LightPreviews.Publish();
     }
 
-    void LightWorker(Level level, const LightSettings& settings) {
+    void LightWorker(Level level, LightSettings editorSettings, LightBakeOptions options) {
         try {
+            auto settings = GetBakeSettings(editorSettings);
             RequestCancelLighting = false;
             Metrics::Reset();
             level.LightDeltaIndices.clear();
@@ -875,134 +1292,164 @@ namespace Inferno::Editor {
             auto availThreads = settings.Multithread && hardwareThreads > 1 ? hardwareThreads - 1 : 1; // leave 1 thread unused
 
             SetAmbientLight(level, settings.Ambient);
+            auto occluders = CreateOccluderBvh(level);
+            constexpr const char* kernelNames[] = { "scalar", "SSE", "AVX" };
+            SPDLOG_INFO("Created occlusion BVH with {} triangles using the {} kernel", occluders.TriangleCount(), kernelNames[(int)occluders.GetKernel()]);
 
-            // Limit the min bucket size, otherwise multithreaded bucketing can fail.
-            // One segment can have 6 lights.
             auto lights = GatherLightSources(level, settings);
-            auto bucketSize = (int)std::max(lights.size() / availThreads, size_t(6));
 
             if (settings.CheckCoplanar)
                 ReduceCoplanarBrightness(level, lights);
 
-            List<LightContext> threads(availThreads);
-            int bucketIndex = 0;
+            // Neighbouring lights are queued on the same worker so they share its visibility results
+            SortLightsSpatially(level, lights);
 
-            constexpr uint BOUNCE_PROGRESS_WEIGHT = 4; // Bounces are generally three to four times slower than direct light
-            TotalLightWork = availThreads * (settings.Bounces * BOUNCE_PROGRESS_WEIGHT + 1);
-            DoneLightWork = 0;
+            auto snapshot = TakeLightingSnapshot(level);
+            UpdateVisibilityCache(Visibility, level, snapshot);
 
-            // assign lights to threads based on their spatial locality
-            std::function<void(OctreeLeaf&)> addNodeLights = [&](const OctreeLeaf& leaf) {
-                if (bucketIndex >= threads.size()) {
-                    // ran out of buckets, dump everything into 0
-                    Seq::append(threads[0].Lights, leaf.Lights);
-                }
-                else if (leaf.Lights.size() <= bucketSize) {
-                    // lights in this leaf fit into a bucket
-                    Seq::append(threads[bucketIndex].Lights, leaf.Lights);
-                    if (threads[bucketIndex].Lights.size() >= bucketSize)
-                        bucketIndex++;
-                }
-                else {
-                    for (int i = 0; i < 8; i++) {
-                        if (leaf.Children[i]) {
-                            addNodeLights(*leaf.Children[i]);
-                        }
-                    }
-                }
-            };
+            List<const LightRayCast*> reusable(lights.size());
+            if (options.Incremental && LastBake)
+                reusable = FindReusableRayCasts(*LastBake, level, snapshot, lights, settings);
 
-            auto tree = CreateLightOctree(level, lights, bucketSize);
-            addNodeLights(tree);
-            Seq::sortBy(threads, [](const LightContext& a, const LightContext& b) {
-                return a.Lights.size() > b.Lights.size();
-            });
+            // Lights can be stolen by any worker, so their results are stored per light instead of per thread
+            List<LightRayCast> rayCasts(lights.size());
+            List<size_t> lightsToCast;
 
-            // Count the number of empty and filled threads
-            int emptyThreads = 0, filledThreads = 0;
-            for (auto& thread : threads) {
-                if (thread.Lights.empty())
-                    emptyThreads++;
+            for (size_t i = 0; i < lights.size(); i++) {
+                if (reusable[i])
+                    rayCasts[i].Accumulated = reusable[i]->Accumulated;
                 else
-                    filledThreads++;
-            }
+                    lightsToCast.push_back(i);
 
-            // Fill empty threads by splitting large buckets
-            for (int i = 0; i < emptyThreads; i++) {
-                auto& src = threads[i].Lights;
-                auto& dst = threads[filledThreads + i].Lights;
-                // move half of the lights to a new thread
-                auto len = src.size() / 2;
-                std::move(src.begin() + len, src.end(), std::back_inserter(dst));
-                src.resize(src.size() - dst.size());
-                //assert(originalLen == src.size() + dst.size());
+                rayCasts[i].Source = &lights[i];
             }
 
-            // If single threaded, preallocate a single large buffer
-            if (availThreads == 1) {
-                threads[0].HitTests = Dictionary<int64, bool>{ 1'000'000 };
-                threads[0].RayCasts = Dictionary<Tag, LightRayCast>{ 1000 };
+            List<LightContext> contexts(availThreads);
+            for (auto& ctx : contexts) {
+                ctx.Pass.Resize(level.Segments.size());
+                ctx.Settings = settings;
+                ctx.Occluders = &occluders;
+                ctx.SharedVisibility = &Visibility.Results;
+                ctx.VisibleSegments = &Visibility.Segments;
             }
 
-            // Dispatch worker threads
-            std::atomic activeThreads = 0;
-            for (auto& ctx : threads) {
-                if (ctx.Lights.empty()) continue;
+            constexpr uint BOUNCE_PROGRESS_WEIGHT = 4; // Bounces are generally three to four times slower than direct light
+            auto bounces = std::clamp(settings.Bounces, 0, 10);
+            TotalLightWork = uint(lightsToCast.size() * (bounces * BOUNCE_PROGRESS_WEIGHT + 1));
+            DoneLightWork = 0;
 
-                ctx.Settings = settings;
-                ctx.Id = activeThreads++;
+            // Give each worker a contiguous range of the sorted lights
+            WorkStealingScheduler<LightTask> scheduler(availThreads);
+            for (size_t i = 0; i < lightsToCast.size(); i++)
+                scheduler.Push(i * availThreads / lightsToCast.size(), { &rayCasts[lightsToCast[i]], 0 });
 
-                // Accumulate radiosity bounces
-                ctx.Thread = std::thread([&ctx, &level] {
-                    SPDLOG_INFO("Dispatching thread {} with {} lights", ctx.Id, ctx.Lights.size());
-                    ctx.EmitDirectLight(level);
+            SPDLOG_INFO("Dispatching {} of {} lights to {} threads", lightsToCast.size(), lights.size(), availThreads);
+
+            auto castLight = [&](LightTask& task, size_t worker) {
+                if (RequestCancelLighting) {
+                    scheduler.Stop();
+                    return;
+                }
+
+                auto& ctx = contexts[worker];
+                auto& cast = *task.Cast;
+                ctx.Tasks++;
+
+                if (task.Pass == 0) {
+                    CastDirectLight(level, cast, ctx);
+                    cast.AccumulatePass();
                     DoneLightWork++;
+                }
+                else {
+                    CastBounces(level, cast, ctx);
+                    cast.AccumulatePass(!(settings.SkipFirstPass && task.Pass == 1));
+                    DoneLightWork += BOUNCE_PROGRESS_WEIGHT;
+                }
 
-                    if (RequestCancelLighting) return;
+                // Queue the next pass on this worker so it runs while the light's targets are still cached.
+                // Progressive bakes wait for every light to finish a pass before starting the next one.
+                if (task.Pass < bounces && !options.Progressive)
+                    scheduler.Push(worker, { task.Cast, task.Pass + 1 });
+            };
 
-                    auto bounces = std::clamp(ctx.Settings.Bounces, 0, 10);
+            bool hasPreview = false; // The level holds the lighting of the last finished pass
 
-                    for (int i = 0; i < bounces; i++) {
-                        for (auto& light : ctx.RayCasts | views::values) {
-                            if (RequestCancelLighting) return;
-                            auto& info = CastBounces(level, light, ctx);
-                            info.AccumulatePass(!(ctx.Settings.SkipFirstPass && i == 0));
-                        }
-                        DoneLightWork += BOUNCE_PROGRESS_WEIGHT;
+            if (options.Progressive) {
+                for (int pass = 0; pass <= bounces && !RequestCancelLighting; pass++) {
+                    if (pass > 0) {
+                        for (size_t i = 0; i < lightsToCast.size(); i++)
+                            scheduler.Push(i * availThreads / lightsToCast.size(), { &rayCasts[lightsToCast[i]], pass });
                     }
 
-                    if (!ctx.Settings.EnableColor)
-                        DesaturateAccumulated(ctx.RayCasts);
+                    scheduler.Run(castLight);
+                    if (RequestCancelLighting) break;
 
-                    SPDLOG_INFO("Thread {} finished. Lights: {} Cache size: {}", ctx.Id, ctx.Lights.size(), ctx.HitTests.size());
-                });
+                    // The final pass is composed below
+                    if (pass < bounces) {
+                        PublishPreview(level, rayCasts, lightsToCast, settings);
+                        hasPreview = true;
+                    }
+                }
+            }
+            else {
+                scheduler.Run(castLight);
+            }
+
+            // Keep the new visibility results even if cancelled, they are valid for the current geometry
+            for (int i = 0; i < contexts.size(); i++) {
+                auto& ctx = contexts[i];
+                SPDLOG_INFO("Thread {} finished. Tasks: {} New ray results: {}", i, ctx.Tasks, ctx.Visibility.Size());
+                Visibility.Results.Merge(ctx.Visibility);
+                ctx.Visibility.Clear();
+                Metrics::CacheHits += ctx.CacheHits;
+                Metrics::RayHits += ctx.HitStats;
+                Metrics::RaysCast += ctx.CastStats;
             }
 
-            for (auto& ctx : threads) {
-                if (ctx.Thread.joinable())
-                    ctx.Thread.join();
+            SPDLOG_INFO("Visibility cache size: {}", Visibility.Results.Size());
+
+            if (Visibility.Results.Size() > MAX_CACHED_RAY_RESULTS) {
+                SPDLOG_INFO("Visibility cache is over its limit, clearing it");
+                Visibility.Results.Clear();
             }
 
-            // User cancelled lighting
-            if (RequestCancelLighting) {
+            if (DiscardBakeCaches.exchange(false)) {
+                // The results are for a level that is no longer loaded
+                ClearBakeCaches();
                 LightWorkerRunning = false;
                 return;
             }
 
-            auto maxValue = std::clamp(settings.MaxValue, 0.0f, 1.0f);
-            const Color max = { maxValue, maxValue, maxValue, 1 };
+            // User cancelled lighting. Keep the last finished pass of a progressive bake.
+            if (RequestCancelLighting) {
+                if (hasPreview) {
+                    SPDLOG_INFO("Lighting cancelled, keeping the last finished pass");
+                    LightLevelResults = level;
+                }
 
-            // Merge the results from each light
-            for (auto& ctx : threads) {
-                // updating the level must be done in serial
-                SetSideLighting(level, ctx.RayCasts, max, settings.EnableColor);
-                SetDynamicLights(level, ctx.RayCasts);
-                Metrics::CacheHits += ctx.CacheHits;
-                Metrics::RayHits += ctx.HitStats;
-                Metrics::RaysCast += ctx.CastStats;
+                LightWorkerRunning = false;
+                return;
+            }
+
+            // Reused results were already desaturated by the bake that cast them
+            if (!settings.EnableColor) {
+                for (auto i : lightsToCast)
+                    DesaturateAccumulated(rayCasts[i]);
             }
 
-            SetVolumeLight(level, settings.AccurateVolumes);
+            // Rebuild the side lighting from every light, so reused and recast results combine the same way as a full bake
+            ComposeLighting(level, rayCasts, settings);
+
+            for (auto& cast : rayCasts)
+                cast.Pass = {}; // Only needed by the next bounce
+
+            LastBake = LightBakeCache{
+                .Settings = settings,
+                .Snapshot = std::move(snapshot),
+                .Lights = std::move(lights),
+                .RayCasts = std::move(rayCasts)
+            };
+
             LightWorkerRunning = false;
             LightLevelResults = level;
         }
@@ -1012,17 +1459,38 @@ namespace Inferno::Editor {
     }
 
     // Lights the level geometry and volumes
-    void Commands::LightLevel(Level& level, const LightSettings& settings) {
+    void Commands::LightLevel(Level& level, const LightSettings& settings, LightBakeOptions options) {
         if (LightWorkerRunning) return; // Already running
         if (LightWorkerThread.joinable()) LightWorkerThread.join(); // shouldn't happen but do it to be safe
 
+        LightPreviews.TryTake(); // Discard a preview of the last bake that was never shown
+        Resources::UpdateAverageTextureColor(level); // Textures may have changed since the level was loaded
         LightWorkerRunning = true;
         DoneLightWork = 0;
-        LightWorkerThread = std::thread(LightWorker, level, std::ref(settings));
+        LightWorkerThread = std::thread(LightWorker, level, settings, options);
+    }
+
+    // Shows the latest finished pass of a progressive bake. Isn't saved to the undo history.
+    void ShowLightPreview(Level& level) {
+        auto preview = LightPreviews.TryTake();
+        if (!preview || preview->VolumeLight.size() != level.Segments.size()) return;
+
+        for (size_t i = 0; i < level.Segments.size(); i++) {
+            auto& seg = level.Segments[i];
+            seg.VolumeLight = preview->VolumeLight[i];
+            for (int side = 0; side < 6; side++)
+                seg.Sides[side].Light = preview->Sides[i * 6 + side];
+        }
+
+        Events::LevelChanged();
     }
 
     void CopyLightResults(Level& level) {
-        if (LightWorkerRunning) return; // Not ready to copy
+        if (LightWorkerRunning) {
+            ShowLightPreview(level);
+            return; // Not ready to copy
+        }
+
         if (LightWorkerThread.joinable()) LightWorkerThread.join(); // Join the worker thread
         if (!LightLevelResults) return; // No results to copy
 
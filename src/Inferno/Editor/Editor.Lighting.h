@@ -25,9 +25,18 @@ namespace Inferno::Editor {
     // Copies the lighting results to a level
     void CopyLightResults(Level& level);
 
+    // Releases the results kept between bakes for incremental relighting. Call when a different level is loaded.
+    void ClearLightingCache();
+
     Color GetLightColor(const SegmentSide& side, bool enableColor);
 
+    // How a bake runs. Doesn't change the final lighting.
+    struct LightBakeOptions {
+        bool Incremental = false; // Only recast the lights near sides that changed since the last bake
+        bool Progressive = false; // Show the lighting after direct light and each bounce. Cancelling keeps the last shown pass.
+    };
+
     namespace Commands {
-        void LightLevel(Level&, const LightSettings&);
+        void LightLevel(Level&, const LightSettings&, LightBakeOptions options = {});
     }
 }
\ No newline at end of file
@@ -9,8 +9,8 @@ namespace Inferno::Editor {
         auto pObj = level.TryGetObject(id);
         if (!pObj) return;
 
-        Events::ObjectsChanged();
         Seq::removeAt(level.Objects, (int)id);
+        Events::ObjectsChanged();
         // Shift object? are there any refs?
     }
 
@@ -48,7 +48,7 @@ namespace Inferno::Editor {
         else
             transform.Translation(face.Center() + normal * distance); // position on face
 
-        obj->Segment = tag.Segment;
+        level.MoveObject(id, tag.Segment);
         obj->SetTransform(transform);
         return true;
     }
@@ -58,7 +58,7 @@ namespace Inferno::Editor {
         auto seg = level.TryGetSegment(segId);
         if (!obj || !seg) return false;
 
-        obj->Segment = segId;
+        level.MoveObject(id, segId);
         obj->Position = seg->Center;
         return true;
     }
@@ -71,7 +71,7 @@ namespace Inferno::Editor {
 
         // Leave the last good ID if nothing contains the object
         auto segId = FindContainingSegment(level, position);
-        if (segId != SegID::None) obj->Segment = segId;
+        if (segId != SegID::None) level.MoveObject(id, segId);
         return true;
     }
 
@@ -330,11 +330,12 @@ namespace Inferno::Editor {
     }
 
     // Updates the segment of the object based on position
-    void UpdateObjectSegment(Level& level, Object& obj) {
+    void UpdateObjectSegment(Level& level, ObjID id) {
+        auto& obj = level.GetObject(id);
         if (!PointInSegment(level, obj.Segment, obj.Position)) {
-            auto id = FindContainingSegment(level, obj.Position);
+            auto segId = FindContainingSegment(level, obj.Position);
             // Leave the last good ID if nothing contains the object
-            if (id != SegID::None) obj.Segment = id;
+            if (segId != SegID::None) level.MoveObject(id, segId);
         }
     }
 
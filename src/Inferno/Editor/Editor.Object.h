@@ -14,7 +14,7 @@ namespace Inferno::Editor {
     void InitObject(const Level&, Object&, ObjectType type);
 
     void UpdateSecretLevelReturnMarker();
-    void UpdateObjectSegment(Level& level, Object& obj);
+    void UpdateObjectSegment(Level& level, ObjID id);
 
     inline bool IsBossRobot(const Object& obj) {
         static Set<int> bossIds = { 17, 23, 31, 45, 46, 52, 62, 64, 75, 76 };
@@ -20,6 +20,9 @@ namespace Inferno::Editor {
 
     List<SelectionHit> HitTestSegments(Level& level, const Ray& ray, bool includeInvisible, SelectionMode mode) {
         List<SelectionHit> hits;
+        auto& cache = level.Collision;
+        cache.Update(level);
+
         int segid = 0;
         for (auto& seg : level.Segments) {
             for (auto& side : SideIDs) {
@@ -31,9 +34,9 @@ namespace Inferno::Editor {
                     if (seg.SideHasConnection(side) && !visibleWall) continue;
                 }
 
-                auto face = Face::FromSide(level, seg, side);
                 float dist;
-                if (face.Intersects(ray, dist) && dist >= Render::Camera.NearClip) {
+                if (cache.IntersectRay(CollisionCache::SideIndex(SegID(segid), side), ray, dist) && dist >= Render::Camera.NearClip) {
+                    auto face = Face::FromSide(level, seg, side);
                     auto intersect = ray.position + dist * ray.direction;
                     int16 edge = 0;
                     if (mode == SelectionMode::Point)
@@ -51,11 +51,20 @@ namespace Inferno::Editor {
         }
 
         void UpdateCleanSnapshot() {
+            SetCleanSnapshot(GetDataSnapshotId());
+        }
+
+        // Returns the snapshot holding the current level data. Pass it to SetCleanSnapshot() once a save finishes,
+        // so edits made while the save was running stay dirty.
+        size_t GetDataSnapshotId() {
             if (auto snapshot = FindDataSnapshot())
-                _cleanId = snapshot->ID;
-            else
-                _cleanId = (size_t)-1;
+                return snapshot->ID;
+
+            return (size_t)-1;
+        }
 
+        void SetCleanSnapshot(size_t id) {
+            _cleanId = id;
             UpdateWindowTitle();
         }
 
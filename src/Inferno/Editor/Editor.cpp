@@ -400,16 +400,16 @@ namespace Inferno::Editor {
         if (lti.EffectClip != EClipID::None) {
             auto& eclip = Resources::GetEffectClip(lti.EffectClip);
             for (auto& frame : eclip.VClip.GetFrames()) {
-                auto& bmp = Resources::GetBitmap(frame);
-                SPDLOG_INFO("Exporting {}", bmp.Info.Name);
-                std::filesystem::remove(bmp.Info.Name + ".png");
-                lodepng::encode(bmp.Info.Name + ".png", (ubyte*)bmp.Data.data(), bmp.Info.Width, bmp.Info.Height);
+                auto bmp = Resources::GetBitmapRef(frame);
+                SPDLOG_INFO("Exporting {}", bmp->Info.Name);
+                std::filesystem::remove(bmp->Info.Name + ".png");
+                lodepng::encode(bmp->Info.Name + ".png", (ubyte*)bmp->Data.data(), bmp->Info.Width, bmp->Info.Height);
             }
         }
         else {
-            auto& bmp = Resources::GetBitmap(lti.TexID);
-            SPDLOG_INFO("Exporting {}", bmp.Info.Name);
-            lodepng::encode(bmp.Info.Name + ".png", (ubyte*)bmp.Data.data(), bmp.Info.Width, bmp.Info.Height);
+            auto bmp = Resources::GetBitmapRef(lti.TexID);
+            SPDLOG_INFO("Exporting {}", bmp->Info.Name);
+            lodepng::encode(bmp->Info.Name + ".png", (ubyte*)bmp->Data.data(), bmp->Info.Width, bmp->Info.Height);
         }
         //lodepng::encode("st/" + bmp.Name + ".png", (ubyte*)bmp.Data.data(), bmp.Width, bmp.Height);
         //lodepng::encode("st/" + bmp.Name + "_st.png", (ubyte*)bmp.Mask.data(), bmp.Width, bmp.Height);
@@ -601,6 +601,33 @@ namespace Inferno::Editor {
         Events::SelectSegment += [] { Editor::Gizmo.UpdatePosition(); };
         Events::LevelChanged += [] { Editor::Gizmo.UpdatePosition(); };
 
+        // Edits can add, remove or renumber objects and segments, so rebuild the objects in each segment
+        Events::LevelLoaded += [] { Game::Level.UpdateSegmentObjects(); };
+        Events::LevelChanged += [] { Game::Level.UpdateSegmentObjects(); };
+        Events::ObjectsChanged += [] { Game::Level.UpdateSegmentObjects(); };
+        Events::SegmentsChanged += [] { Game::Level.UpdateSegmentObjects(); };
+        Events::SnapshotChanged += [] { Game::Level.UpdateSegmentObjects(); };
+
+        // Only recaches the triangles of segments whose geometry changed
+        Events::LevelLoaded += [] { Game::Level.Collision.Update(Game::Level); };
+        Events::LevelLoaded += [] { ClearLightingCache(); };
+        Events::LevelChanged += [] { Game::Level.Collision.Update(Game::Level); };
+        Events::SegmentsChanged += [] { Game::Level.Collision.Update(Game::Level); };
+        Events::SnapshotChanged += [] { Game::Level.Collision.Update(Game::Level); };
+
+        Events::LevelSaved += [](const SaveResult& result) {
+            if (!result.Error.empty()) {
+                SPDLOG_ERROR("Unable to save {}: {}", result.Path.string(), result.Error);
+                if (!result.Autosave) ShowErrorMessage(Convert::ToWideString(result.Error));
+            }
+            else if (result.Autosave) {
+                SPDLOG_INFO(L"Autosaved to {}", result.Path.wstring());
+            }
+            else {
+                SetStatusMessage(L"Saved to {}", result.Path.filename().wstring());
+            }
+        };
+
         if (Settings::Editor.ReopenLastLevel &&
             !Settings::Editor.RecentFiles.empty() &&
             filesystem::exists(Settings::Editor.RecentFiles.front())) {
@@ -31,6 +31,12 @@ namespace Inferno::Editor {
         Briefings
     };
 
+    struct SaveResult {
+        filesystem::path Path;
+        bool Autosave = false;
+        string Error; // Empty on success
+    };
+
     namespace Events {
         inline Event SelectSegment, SelectObject, LevelLoaded;
         inline Event MarkedFacesChanged;
@@ -44,5 +50,6 @@ namespace Inferno::Editor {
         inline Event<DialogType> ShowDialog; // More of a command than an event
         inline Event SettingsChanged;
         inline Event SnapshotChanged; // Snapshot undo/redo
+        inline Event<const SaveResult&> LevelSaved; // A background save finished or failed
     }
 }
@@ -249,10 +249,8 @@ namespace Inferno::Editor {
             try {
                 HogWriter writer(tempPath);
 
-                for (auto& entry : _entries) {
-                    auto data = source.ReadEntry(entry);
-                    writer.WriteEntry(entry.Name, data);
-                }
+                for (auto& entry : _entries)
+                    writer.CopyEntry(source, entry, entry.Name);
             }
             catch (const std::exception& e) {
                 ShowErrorMessage(e);
@@ -260,6 +258,7 @@ namespace Inferno::Editor {
                 return;
             }
 
+            source.Unmap(); // Release the file so it can be replaced
             BackupFile(source.Path);
             filesystem::remove(source.Path); // Remove existing
             filesystem::rename(tempPath, source.Path); // Rename temp to destination
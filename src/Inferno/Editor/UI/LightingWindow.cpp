@@ -103,6 +103,13 @@ namespace Inferno::Editor {
             ImGui::Checkbox("Multithread", &settings.Multithread);
             ImGui::HelpMarker("Enables multithread calculations");
 
+            ImGui::Checkbox("Progressive", &_progressive);
+            ImGui::HelpMarker("Shows the lighting after direct light and each bounce while the rest is calculated.\nCancelling keeps the last pass shown.");
+
+            ImGui::SameLine();
+            ImGui::Checkbox("Preview", &settings.Preview);
+            ImGui::HelpMarker("Uses at most one bounce and skips dim bounce sources.\nFaster but less accurate, for judging changes.");
+
             /*ImGui::Checkbox("Check Coplanar", &_settings.CheckCoplanar);
                 ImGui::HelpMarker("Causes co-planar light sources to have a consistent brightness");*/
         }
@@ -117,7 +124,13 @@ namespace Inferno::Editor {
             }
             else {
                 if (ImGui::Button("Light Level", size))
-                    Commands::LightLevel(Game::Level, settings);
+                    Commands::LightLevel(Game::Level, settings, { .Progressive = _progressive });
+
+                ImGui::SameLine();
+                if (ImGui::Button("Relight Changes"))
+                    Commands::LightLevel(Game::Level, settings, { .Incremental = true, .Progressive = _progressive });
+
+                ImGui::HelpMarker("Only recalculates lights near sides that changed since the last bake.\nLights everything if the settings or segment count changed.");
             }
         }
 
@@ -4,6 +4,8 @@
 
 namespace Inferno::Editor {
     class LightingWindow final : public WindowBase {
+        bool _progressive = true;
+
     public:
         LightingWindow();
 
@@ -55,11 +55,12 @@ namespace Inferno::Editor {
         auto levelTextures = Render::GetLevelSegmentTextures(Game::Level);
 
         for (int i = 1; i < Resources::GetTextureCount(); i++) {
-            auto& bmp = Resources::GetBitmap((TexID)i);
-            auto type = ClassifyTexture(bmp.Info);
+            // Only the info is needed, so demand paged textures aren't decoded
+            auto& ti = Resources::GetTextureInfo((TexID)i);
+            auto type = ClassifyTexture(ti);
 
-            if ((_showModified && bmp.Info.Custom) ||
-                (_showInUse && levelTextures.contains(bmp.Info.ID))) {
+            if ((_showModified && ti.Custom) ||
+                (_showInUse && levelTextures.contains(ti.ID))) {
                 // show if modified or in use
             }
             else {
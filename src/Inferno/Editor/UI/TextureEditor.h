@@ -84,8 +84,6 @@ namespace Inferno::Editor {
                                 continue;
                         }
 
-                        auto& bmp = Resources::GetBitmap(id);
-
                         auto& material = Render::Materials->Get(id);
                         bool selected = id == _selection;
 
@@ -111,7 +109,7 @@ namespace Inferno::Editor {
 
                         ImGui::TableNextColumn();
                         ImGui::AlignTextToFramePadding();
-                        ImGui::Text(bmp.Info.Name.c_str());
+                        ImGui::Text(ti.Name.c_str());
                         if (ImGui::IsItemVisible()) {
                             std::array ids{ id };
                             Render::Materials->LoadMaterialsAsync(ids);
@@ -128,7 +126,7 @@ namespace Inferno::Editor {
                         ImGui::Text(transparent);
 
                         ImGui::TableNextColumn();
-                        ImGui::Text(bmp.Info.Custom ? "Yes" : "No");
+                        ImGui::Text(ti.Custom ? "Yes" : "No");
                     }
 
                     ImGui::EndTable();
@@ -140,8 +138,8 @@ namespace Inferno::Editor {
                 ImGui::SameLine();
                 ImGui::BeginChild("details", { detailWidth, ImGui::GetWindowSize().y - bottomHeight });
 
-                auto& bmp = Resources::GetBitmap(_selection);
-                auto& ti = bmp.Info;
+                auto bmp = Resources::GetBitmapRef(_selection);
+                auto& ti = bmp->Info;
                 if (ti.ID > TexID::Invalid) {
                     //auto ti = Resources::GetTextureInfo(_selection);
                     auto& material = Render::Materials->Get(_selection);
@@ -179,7 +177,7 @@ namespace Inferno::Editor {
 
                         ImGui::Dummy({ 0, 10 * Shell::DpiScale });
                         if (ImGui::Button("Export", { 100 * Shell::DpiScale, 0 })) {
-                            OnExport(bmp.Info.ID);
+                            OnExport(ti.ID);
                         }
 
                         {
@@ -223,10 +221,10 @@ namespace Inferno::Editor {
     private:
         static void OnExport(TexID id) {
             try {
-                auto& bmp = Resources::GetBitmap(id);
+                auto bmp = Resources::GetBitmapRef(id);
                 static constexpr COMDLG_FILTERSPEC filter[] = { { L"256 Color Bitmap", L"*.BMP" } };
-                if (auto path = SaveFileDialog(filter, 0, Convert::ToWideString(bmp.Info.Name + ".bmp"), L"Export BMP")) {
-                    WriteBmp(*path, Resources::GetPalette(), bmp);
+                if (auto path = SaveFileDialog(filter, 0, Convert::ToWideString(bmp->Info.Name + ".bmp"), L"Export BMP")) {
+                    WriteBmp(*path, Resources::GetPalette(), *bmp);
                 }
             }
             catch (const std::exception& e) {
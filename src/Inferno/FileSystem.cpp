@@ -2,6 +2,7 @@
 #include <fstream>
 #include <ranges>
 #include "FileSystem.h"
+#include "Utility.h"
 #include "Game.h"
 #include "Settings.h"
 
@@ -29,6 +30,24 @@ void Inferno::File::WriteAllBytes(const std::filesystem::path& path, span<ubyte>
     SPDLOG_INFO("Wrote {} bytes to {}", data.size(), path.string());
 }
 
+void Inferno::File::WriteAllBytesAtomic(const std::filesystem::path& path, span<const ubyte> data, string_view backupExtension) {
+    auto temp = TemporaryPath(path);
+
+    {
+        std::ofstream file(temp, std::ios::binary);
+        file.write((const char*)data.data(), data.size());
+        file.close();
+
+        if (!file) {
+            std::error_code ec;
+            filesystem::remove(temp, ec);
+            throw Exception(fmt::format("Unable to write {}", path.string()));
+        }
+    }
+
+    ReplaceWithBackup(temp, path, backupExtension);
+}
+
 namespace Inferno::FileSystem {
     List<filesystem::path> Directories;
 
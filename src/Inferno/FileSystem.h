@@ -6,6 +6,10 @@ namespace Inferno::File {
     // Reads the file at the given path. Throws an exception if not found.
     List<ubyte> ReadAllBytes(const std::filesystem::path& path);
     void WriteAllBytes(const std::filesystem::path& path, span<ubyte> data);
+
+    // Writes to a temporary file and renames it over the destination, so an interrupted write can't leave a partial file.
+    // If backupExtension is not empty the previous file is kept with that extension.
+    void WriteAllBytesAtomic(const std::filesystem::path& path, span<const ubyte> data, string_view backupExtension = {});
 }
 
 /*
@@ -46,7 +46,7 @@ namespace Inferno::Game {
     }
 
     void LoadMission(const filesystem::path& file) {
-        Mission = HogFile::Read(FileSystem::FindFile(file));
+        Mission = HogFile::Read(FileSystem::FindFile(file), true);
     }
 
     // Tries to read the mission file (msn / mn2) for the loaded mission
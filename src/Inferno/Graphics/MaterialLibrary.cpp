@@ -472,7 +472,7 @@ namespace Inferno::Render {
             material.Handles[i] = Render::Uploads->GetGpuHandle(material.UploadIndex + i);
 
         material.Name = bitmap.Name;
-        material.Textures[Material2D::Diffuse].Load(batch, bitmap.Mips[0].data(), bitmap.Width, bitmap.Height, Convert::ToWideString(bitmap.Name));
+        material.Textures[Material2D::Diffuse].Load(batch, bitmap.GetMip(0).data(), bitmap.Width, bitmap.Height, Convert::ToWideString(bitmap.Name));
 
         // Set default secondary textures
         for (uint i = 0; i < std::size(material.Textures); i++) {
@@ -608,12 +608,12 @@ namespace Inferno::Render {
         if (!forceLoad && slot.State == TextureState::Resident) return {};
         if (slot.State == TextureState::PagingIn) return {};
 
-        auto& bitmap = Resources::GetBitmap(id);
-        if (bitmap.Info.Width == 0 || bitmap.Info.Height == 0)
+        auto bitmap = Resources::GetBitmapRef(id);
+        if (bitmap->Info.Width == 0 || bitmap->Info.Height == 0)
             return {};
 
         MaterialUpload upload;
-        upload.Bitmap = &bitmap;
+        upload.Bitmap = std::move(bitmap);
         upload.ID = id;
         upload.SuperTransparent = Resources::GetTextureInfo(id).SuperTransparent;
         slot.State = TextureState::PagingIn;
@@ -750,28 +750,44 @@ namespace Inferno::Render {
         }
 
         if (!hasUnloaded) return;
-        Render::Adapter->WaitForGpu();
 
-        List<Material2D> uploads;
-        auto batch = BeginTextureUpload();
+        auto isVClip = [](const string& file) { return file.ends_with(".oaf") || file.ends_with(".OAF"); };
+
+        // Find the textures to load first so the bitmaps can be decoded together
+        List<std::pair<TexID, const Outrage::TextureInfo*>> pending;
+        List<string> bitmapNames;
 
         for (auto& index : indices) {
             if (index < OUTRAGE_TEXID_START) continue;
             if (!Seq::inRange(_materials, (int)index)) continue;
             if (_materials[(int)index].State == TextureState::Resident || _materials[(int)index].State == TextureState::PagingIn) continue;
 
-            Material2D material;
-
             auto entry = Seq::tryItem(Resources::GameTable.Textures, (int)index - (int)Render::OUTRAGE_TEXID_START);
             if (!entry) continue;
 
-            if (entry->FileName.ends_with(".oaf") || entry->FileName.ends_with(".OAF")) {
+            pending.push_back({ index, entry });
+            if (!isVClip(entry->FileName))
+                bitmapNames.push_back(entry->FileName);
+        }
+
+        auto bitmaps = Resources::ReadOutrageBitmaps(bitmapNames);
+        size_t bitmapIndex = 0;
+
+        Render::Adapter->WaitForGpu();
+
+        List<Material2D> uploads;
+        auto batch = BeginTextureUpload();
+
+        for (auto& [index, entry] : pending) {
+            Material2D material;
+
+            if (isVClip(entry->FileName)) {
                 if (auto bitmap = Resources::ReadOutrageVClip(entry->FileName)) {
                     material = UploadOutrageMaterial(batch, *bitmap, Render::StaticTextures->Black);
                 }
             }
-            else if (auto bitmap = Resources::ReadOutrageBitmap(entry->FileName)) {
-                // Try loading file from D3 data
+            else if (auto& bitmap = bitmaps[bitmapIndex++]) {
+                // Decoded from D3 data
                 material = UploadOutrageMaterial(batch, *bitmap, Render::StaticTextures->Black);
             }
             else {
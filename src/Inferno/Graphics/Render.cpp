@@ -17,6 +17,7 @@
 #include "Render.Particles.h"
 #include "Game.Segment.h"
 #include "Game.Text.h"
+#include "SegmentVisibility.h"
 #include "Editor/UI/BriefingEditor.h"
 
 using namespace DirectX;
@@ -42,8 +43,16 @@ namespace Inferno::Render {
 
         Ptr<MeshBuffer> _meshBuffer;
         Ptr<SpriteBatch> _tempBatch;
+
+        SegmentVisibility _visibleSegments; // Sight passes through every connected side, as walls can be transparent
+        int _visibilityStaleFrames = -1; // Frames since the level last changed. -1 when the visibility is up to date.
+        SegID _cameraSegment = SegID::None;
     }
 
+    // Gizmo drags change the level every frame, so visibility is only rebuilt once the level stops changing.
+    // Nothing is culled by segment while it is out of date.
+    constexpr int VISIBILITY_REBUILD_DELAY = 15; // Frames
+
     struct RenderBatchHandle {
         int IndexOffset;
         int BufferOffset;
@@ -643,6 +652,19 @@ namespace Inferno::Render {
     }
 
 
+    // Returns true if anything in a segment could be visible from the camera
+    bool SegmentMightBeVisible(SegID id) {
+        if (_cameraSegment == SegID::None) return true; // Camera is outside of the level
+        if (!Seq::inRange(Game::Level.Segments, (int)id)) return true;
+        if (_visibilityStaleFrames >= 0 || _visibleSegments.SegmentCount() != Game::Level.Segments.size()) return true; // Not updated yet
+        return _visibleSegments.CanSee(_cameraSegment, id);
+    }
+
+    void UpdateCameraSegment(Level& level) {
+        if (Editor::PointInSegment(level, _cameraSegment, Camera.Position)) return;
+        _cameraSegment = Editor::FindContainingSegment(level, Camera.Position);
+    }
+
     void DrawObject(Level& level, Object& obj, float distSquared, float alpha) {
         auto position = Vector3::Lerp(obj.LastPosition, obj.Position, alpha);
 
@@ -702,8 +724,15 @@ namespace Inferno::Render {
         if (LevelChanged) {
             Adapter->WaitForGpu();
             _levelMeshBuilder.Update(Game::Level, *_levelMeshBuffer);
+            _visibilityStaleFrames = 0;
             LevelChanged = false;
         }
+        else if (_visibilityStaleFrames >= 0 && ++_visibilityStaleFrames > VISIBILITY_REBUILD_DELAY) {
+            _visibleSegments.Update(Game::Level);
+            _visibilityStaleFrames = -1;
+        }
+
+        UpdateCameraSegment(Game::Level);
 
         ScopedTimer levelTimer(&Metrics::QueueLevel);
         if (Settings::Editor.RenderMode != RenderMode::None) {
@@ -711,7 +740,9 @@ namespace Inferno::Render {
             for (auto& mesh : _levelMeshBuilder.GetMeshes())
                 DrawOpaque({ &mesh, 0 });
 
+            // Opaque meshes combine every side with the same texture, so only walls can be culled by segment
             for (auto& mesh : _levelMeshBuilder.GetWallMeshes()) {
+                if (!SegmentMightBeVisible((SegID)mesh.Chunk->ID)) continue;
                 float depth = (mesh.Chunk->Center - Camera.Position).LengthSquared();
                 DrawTransparent({ &mesh, depth });
             }
@@ -719,9 +750,35 @@ namespace Inferno::Render {
 
         if (Settings::Editor.ShowObjects) {
             auto distSquared = Settings::Editor.ObjectRenderDistance * Settings::Editor.ObjectRenderDistance;
-            for (auto& obj : Game::Level.Objects) {
-                if (obj.Lifespan <= 0) continue;
-                DrawObject(Game::Level, obj, distSquared, lerp);
+
+            // Objects are only hidden by segment when the level geometry in front of them is drawn
+            bool cullBySegment = Settings::Editor.RenderMode != RenderMode::None &&
+                _cameraSegment != SegID::None && _visibilityStaleFrames < 0 &&
+                _visibleSegments.SegmentCount() == Game::Level.Segments.size();
+
+            if (cullBySegment) {
+                // Only visit the objects of segments the camera can see
+                for (int segId = 0; segId < Game::Level.Segments.size(); segId++) {
+                    if (!_visibleSegments.CanSee(_cameraSegment, (SegID)segId)) continue;
+
+                    for (auto id : Game::Level.Segments[segId].Objects) {
+                        auto& obj = Game::Level.GetObject(id);
+                        if (obj.Lifespan <= 0 || obj.Segment != (SegID)segId) continue;
+                        DrawObject(Game::Level, obj, distSquared, lerp);
+                    }
+                }
+
+                // Objects without a valid segment aren't in any list, but the editor still needs to show them
+                for (auto& obj : Game::Level.Objects) {
+                    if (obj.Lifespan <= 0 || Game::Level.SegmentExists(obj.Segment)) continue;
+                    DrawObject(Game::Level, obj, distSquared, lerp);
+                }
+            }
+            else {
+                for (auto& obj : Game::Level.Objects) {
+                    if (obj.Lifespan <= 0) continue;
+                    DrawObject(Game::Level, obj, distSquared, lerp);
+                }
             }
         }
 
@@ -11,6 +11,8 @@
 #include "Editor/Events.h"
 #include "Graphics/Render.Particles.h"
 #include "Game.Wall.h"
+#include "Parallel.h"
+#include "SegmentWalk.h"
 
 using namespace DirectX;
 
@@ -164,10 +166,6 @@ namespace Inferno {
 
             physics.Thrust *= ship.MaxThrust / dt;
             physics.AngularThrust *= ship.MaxRotationalThrust / dt;
-
-            Debug::ShipThrust = physics.AngularThrust;
-            Debug::ShipAcceleration = Vector3::Zero;
-
         }
 
         AngularPhysics(obj, dt);
@@ -482,6 +480,34 @@ namespace Inferno {
         return hit;
     }
 
+    // Returns the nearest intersection point on the cached triangles of a side
+    HitInfo IntersectSideSphere(const CollisionCache& cache, int side, const BoundingSphere& sphere) {
+        HitInfo hit;
+
+        for (int tri = side * 2; tri < side * 2 + 2; tri++) {
+            if (std::abs(cache.PlaneDistance(tri, sphere.Center)) > sphere.Radius) continue; // too far from the plane to touch
+
+            auto& p0 = cache.V0(tri);
+            auto& p1 = cache.V1(tri);
+            auto& p2 = cache.V2(tri);
+
+            if (sphere.Intersects(p0, p1, p2)) {
+                auto p = ClosestPointOnTriangle(p0, p1, p2, sphere.Center);
+                auto dist = (p - sphere.Center).Length();
+                if (dist < hit.Distance) {
+                    hit.Point = p;
+                    hit.Distance = dist;
+                }
+            }
+        }
+
+        if (hit.Distance > sphere.Radius)
+            hit.Distance = FLT_MAX;
+        else
+            (hit.Point - sphere.Center).Normalize(hit.Normal);
+
+        return hit;
+    }
 
     Tuple<Vector3, float> IntersectTriangleSphere(const Vector3& p0, const Vector3& p1, const Vector3& p2, const BoundingSphere& sphere) {
         if (sphere.Intersects(p0, p1, p2)) {
@@ -494,181 +520,175 @@ namespace Inferno {
         return { {}, FLT_MAX };
     }
 
-    struct BoundingCapsule {
-        Vector3 A, B;
-        float Radius;
-
-        HitInfo Intersects(const BoundingSphere& sphere) const {
-            HitInfo hit{};
-
-            //, Vector3& refPoint, float& dist, Vector3& normal
-            // Compute (squared) distance between sphere center and capsule line segment
-            auto p = ClosestPointOnLine(B, A, sphere.Center);
-            BoundingSphere cap(p, Radius);
-            return IntersectSphereSphere(cap, sphere);
-            //auto dist = Vector3::Distance(sphere.Center, p);
-            //auto vec = p - sphere.Center;
-            //vec.Normalize(normal);
-            //refPoint = sphere.Center + normal * sphere.Radius;
-            //// If (squared) distance smaller than (squared) sum of radii, they collide
-            //float dist2 = Vector3::DistanceSquared(sphere.Center, p);
-            //float r = Radius + sphere.Radius;
-            //if (dist2 <= r * r)
-            //    hit.Distance = dist;
-
-            //return dist2 <= r * r;
-            //return hit;
-        }
+    // First contact of a sphere moving along a segment
+    struct SweepHit {
+        float Time = FLT_MAX; // Fraction of the motion before the contact
+        Vector3 Point; // Contact point on the other shape
+        Vector3 Normal; // Points from the contact towards the center of the moving sphere
+    };
 
-        bool Intersects(const BoundingCapsule& other) const {
-            // Compute (squared) distance between the inner structures of the capsules
-            auto p = ClosestPointBetweenLines(A, B, other.A, other.B);
-            // If (squared) distance smaller than (squared) sum of radii, they collide
-            float r = Radius + other.Radius;
-            return p.distSq <= r * r;
+    // Earliest fraction of the motion that a moving sphere touches a point. Zero if it starts touching.
+    bool SweepSpherePoint(const Vector3& start, const Vector3& delta, float radius, const Vector3& point, float& time) {
+        auto m = start - point;
+        auto c = m.Dot(m) - radius * radius;
+        if (c <= 0) {
+            time = 0;
+            return true;
         }
 
-        bool Intersects(const Vector3& p0, const Vector3& p1, const Vector3& p2, const Vector3& /*faceNormal*/, Vector3& refPoint, Vector3& normal, float& dist) const {
-            if (p0 == p1 || p1 == p2 || p2 == p0) return false; // Degenerate check
-            auto base = A;
-            auto tip = B;
-            // Compute capsule line endpoints A, B like before in capsule-capsule case:
-            auto capsuleNormal = tip - base;
-            capsuleNormal.Normalize();
-            auto offset = capsuleNormal * Radius; // line end offset
-            auto a = base + offset; // base
-            auto b = tip - offset; // tip
-
-            //Render::Debug::DrawLine(a, b, { 1, 0, 0 });
-
-            // Project the line onto plane
-            Ray r(A, capsuleNormal);
-            Plane p(p0, p1, p2);
-            auto linePlaneIntersect = ProjectRayOntoPlane(r, p0, p.Normal());
-            auto inside = PointInTriangle(p0, p1, p2, linePlaneIntersect);
-
-            if (inside) {
-                refPoint = linePlaneIntersect;
-                //Render::Debug::DrawPoint(refPoint, { 0, 1, 0 });
-            }
-            else {
-                refPoint = ClosestPointOnTriangle(p0, p1, p2, linePlaneIntersect);
-                //Render::Debug::DrawPoint(refPoint, { 0, 1, 1 });
-            }
-
-            auto center = ClosestPointOnLine(A, B, refPoint);
-            BoundingSphere sphere(center, Radius);
-
-            auto [point, idist] = IntersectTriangleSphere(p0, p1, p2, sphere);
-            refPoint = point;
+        auto a = delta.Dot(delta);
+        auto b = m.Dot(delta);
+        if (b >= 0 || a <= 0) return false; // moving away
 
-            normal = center - point;
-            normal.Normalize();
-            dist = idist;
-            return idist < Radius;
+        auto disc = b * b - a * c;
+        if (disc < 0) return false;
 
-            //float t;
-            //if(!r.Intersects(p, t))
-            //    return false;
+        time = (-b - sqrt(disc)) / a;
+        return time <= 1;
+    }
 
-            //float t = faceNormal.Dot((p0 - base) / std::abs(capsuleNormal.Dot(faceNormal)));
-            //auto linePlaneIntersect = base + capsuleNormal * t;
+    // Earliest fraction of the motion that a moving sphere touches the inside of an edge.
+    // Doesn't report spheres that start touching it, or contacts past the ends, which the end points cover.
+    bool SweepSphereEdge(const Vector3& start, const Vector3& delta, float radius, const Vector3& p, const Vector3& q, float& time, Vector3& contact) {
+        auto e = q - p;
+        auto m = start - p;
+        auto ee = e.Dot(e), ed = e.Dot(delta), em = e.Dot(m);
+        if (ee <= 0) return false;
 
+        // Solve for the distance from the line being the radius, with the motion projected off the edge direction
+        auto a = ee * delta.Dot(delta) - ed * ed;
+        if (a <= FLT_EPSILON * ee * delta.Dot(delta)) return false; // moving parallel to the edge
 
-            //Render::Debug::DrawLine(b, linePlaneIntersect, { 1, 1, 1 });
+        auto b = ee * m.Dot(delta) - em * ed;
+        auto c = ee * (m.Dot(m) - radius * radius) - em * em;
+        auto disc = b * b - a * c;
+        if (disc < 0) return false;
 
-            ///*Vector3*/ refPoint = ClosestPointOnTriangle(p0, p1, p2, linePlaneIntersect);
+        auto t = (-b - sqrt(disc)) / a;
+        if (t < 0 || t > 1) return false;
 
-            //auto c0 = (linePlaneIntersect - p0).Cross(p1 - p0);
-            //auto c1 = (linePlaneIntersect - p1).Cross(p2 - p1);
-            //auto c2 = (linePlaneIntersect - p2).Cross(p0 - p2);
-            //bool inside = c0.Dot(faceNormal) <= 0 && c1.Dot(faceNormal) <= 0 && c2.Dot(faceNormal) <= 0;
+        auto s = (em + t * ed) / ee;
+        if (s < 0 || s > 1) return false;
 
+        time = t;
+        contact = p + e * s;
+        return true;
+    }
 
+    // Sweeps a sphere against a triangle. The face is checked first since touching it comes before any edge.
+    bool SweepSphereTriangle(const Vector3& start, const Vector3& delta, float radius,
+                             const Vector3& p0, const Vector3& p1, const Vector3& p2, const Vector3& normal, SweepHit& hit) {
+        auto closest = ClosestPointOnTriangle(p0, p1, p2, start);
+        if (Vector3::DistanceSquared(closest, start) <= radius * radius) {
+            hit.Time = 0;
+            hit.Point = closest;
+            hit.Normal = start - closest;
+            if (hit.Normal.LengthSquared() > 0)
+                hit.Normal.Normalize();
+            else
+                hit.Normal = normal; // center is on the triangle
+            return true;
+        }
 
-            //if (inside) {
-            //    Render::Debug::DrawPoint(linePlaneIntersect, { 1, 0, 0 });
-            //    refPoint = linePlaneIntersect;
-            //}
-            //else {
-            //    // Edge 1:
-            //    auto point1 = ClosestPointOnLine(p0, p1, linePlaneIntersect);
-            //    auto v1 = linePlaneIntersect - point1;
-            //    auto distsq = v1.Dot(v1);
-            //    auto bestDist = distsq;
-            //    refPoint = point1;
+        auto dist = normal.Dot(start - p0);
+        auto side = dist >= 0 ? 1.0f : -1.0f;
+        auto approach = normal.Dot(delta) * side; // negative when moving towards the plane
+
+        if (approach < 0) {
+            auto t = (std::abs(dist) - radius) / -approach;
+            if (t >= 0 && t <= 1) {
+                auto point = start + delta * t - normal * side * radius;
+                if (PointInTriangle(p0, p1, p2, point)) {
+                    hit = { t, point, normal * side };
+                    return true;
+                }
+            }
+        }
 
-            //    // Edge 2:
-            //    auto point2 = ClosestPointOnLine(p1, p2, linePlaneIntersect);
-            //    auto v2 = linePlaneIntersect - point2;
-            //    distsq = v2.Dot(v2);
-            //    if (distsq < bestDist) {
-            //        refPoint = point2;
-            //        bestDist = distsq;
-            //    }
+        const Vector3* points[] = { &p0, &p1, &p2 };
+        hit.Time = FLT_MAX;
 
-            //    // Edge 3:
-            //    auto point3 = ClosestPointOnLine(p2, p0, linePlaneIntersect);
-            //    auto v3 = linePlaneIntersect - point3;
-            //    distsq = v3.Dot(v3);
-            //    if (distsq < bestDist) {
-            //        refPoint = point3;
-            //        bestDist = distsq;
-            //    }
-            //}
+        for (int i = 0; i < 3; i++) {
+            float t{};
+            Vector3 contact;
+            if (SweepSphereEdge(start, delta, radius, *points[i], *points[(i + 1) % 3], t, contact) && t < hit.Time) {
+                hit.Time = t;
+                hit.Point = contact;
+            }
 
-            // The center of the best sphere candidate:
-            /*Vector3*/
-            //Render::Debug::DrawPoint(refPoint, { 1, 1, 0 });
+            if (SweepSpherePoint(start, delta, radius, *points[i], t) && t < hit.Time) {
+                hit.Time = t;
+                hit.Point = *points[i];
+            }
+        }
 
-            // Determine whether point is inside all triangle edges:
-            //bool inside = PointInTriangle(p0, p1, p2, linePlaneIntersect);
+        if (hit.Time > 1) return false;
 
+        hit.Normal = start + delta * hit.Time - hit.Point;
+        hit.Normal.Normalize();
+        return true;
+    }
 
-        }
-    };
+    // Sweeps two moving spheres against each other
+    bool SweepSphereSphere(const Vector3& start, const Vector3& delta, float radius,
+                           const Vector3& otherStart, const Vector3& otherDelta, float otherRadius, SweepHit& hit) {
+        // Relative to the other sphere, the moving sphere sweeps against a point with the combined radius
+        float t{};
+        if (!SweepSpherePoint(start - otherStart, delta - otherDelta, radius + otherRadius, Vector3::Zero, t))
+            return false;
+
+        auto center = start + delta * t;
+        auto otherCenter = otherStart + otherDelta * t;
+        hit.Time = t;
+        (center - otherCenter).Normalize(hit.Normal);
+        hit.Point = otherCenter + hit.Normal * otherRadius;
+        return true;
+    }
 
     // Finds the nearest sphere-level intersection
-    bool IntersectLevel(Level& level, const BoundingSphere& sphere, SegID segId, ObjID oid, LevelHit& hit) {
-        auto& seg = level.GetSegment(segId);
-        hit.Visited.insert(segId);
-
+    bool IntersectLevel(Level& level, const BoundingSphere& sphere, SegID start, ObjID oid, LevelHit& hit, SegmentWalk& walk) {
         auto& obj = level.Objects[(int)oid];
+        auto& cache = level.Collision;
+        walk.Begin(level, start);
 
-        // Did we hit any objects in this segment?
-        for (int i = 0; i < level.Objects.size(); i++) {
-            auto& other = level.Objects[i];
-            //if (!Object::IsAlive(obj) || obj.Segment != segId) continue;
-            //if (hit.Source && hit.Source->Parent == (ObjID)i) continue; // don't hit parent
-            //if (hit.Source == &obj) continue; // don't hit yourself!
-            //if (source.Parent == obj.Parent) continue; // Don't hit your siblings!
-
-            if (!Object::IsAlive(other) || other.Segment != segId) continue;
-            if (oid == (ObjID)i) continue; // don't hit yourself!
-            if (obj.Parent == other.Parent) continue; // Don't hit your siblings!
-            if (oid == other.Parent) continue; // Don't hit your children!
-
-            BoundingSphere objSphere(other.Position, other.Radius);
-            if (auto info = IntersectSphereSphere(sphere, objSphere)) {
-                hit.Update(info, &other);
+        SegID segId{};
+        while (walk.Pop(segId)) {
+            auto& seg = level.GetSegment(segId);
+
+            // Did we hit any objects in this segment?
+            for (auto otherId : seg.Objects) {
+                auto& other = level.GetObject(otherId);
+                //if (hit.Source && hit.Source->Parent == (ObjID)i) continue; // don't hit parent
+                //if (hit.Source == &obj) continue; // don't hit yourself!
+                //if (source.Parent == obj.Parent) continue; // Don't hit your siblings!
+
+                if (!Object::IsAlive(other) || other.Segment != segId) continue;
+                if (oid == otherId) continue; // don't hit yourself!
+                if (obj.Parent == other.Parent) continue; // Don't hit your siblings!
+                if (oid == other.Parent) continue; // Don't hit your children!
+
+                BoundingSphere objSphere(other.Position, other.Radius);
+                if (auto info = IntersectSphereSphere(sphere, objSphere)) {
+                    hit.Update(info, &other);
+                }
             }
-        }
 
-        for (auto& side : SideIDs) {
-            auto face = Face::FromSide(level, segId, side);
+            for (auto& side : SideIDs) {
+                auto index = CollisionCache::SideIndex(segId, side);
 
-            if (auto h = IntersectFaceSphere(face, sphere)) {
-                if (h.Normal.Dot(face.AverageNormal()) > 0)
-                    continue; // passed through back of face
+                if (auto h = IntersectSideSphere(cache, index, sphere)) {
+                    if (h.Normal.Dot(seg.GetSide(side).AverageNormal) > 0)
+                        continue; // passed through back of face
 
-                if (seg.SideIsSolid(side, level)) {
-                    hit.Update(h, { segId, side }); // hit a solid wall
-                }
-                else {
-                    // intersected with a connected side, must check faces in it too
-                    auto conn = seg.GetConnection(side);
-                    if (conn > SegID::None && !hit.Visited.contains(conn))
-                        IntersectLevel(level, sphere, conn, oid, hit); // Recursive
+                    if (cache.IsSolid(index, level)) {
+                        hit.Update(h, { segId, side }); // hit a solid wall
+                    }
+                    else {
+                        // intersected with a connected side, must check faces in it too
+                        auto conn = seg.GetConnection(side);
+                        if (conn > SegID::None)
+                            walk.Push(conn);
+                    }
                 }
             }
         }
@@ -679,19 +699,22 @@ namespace Inferno {
 
     // intersects a ray with the level, returning hit information
     bool IntersectLevel(Level& level, const Ray& ray, SegID start, float maxDist, LevelHit& hit) {
+        auto& cache = level.Collision;
+        if (cache.SegmentCount() != level.Segments.size()) return false; // not cached yet
+
         SegID segId = start;
 
         while (segId > SegID::None) {
             auto& seg = level.GetSegment(segId);
 
             for (auto& side : SideIDs) {
-                auto face = Face::FromSide(level, seg, side);
+                auto index = CollisionCache::SideIndex(segId, side);
 
                 float dist{};
-                if (face.Intersects(ray, dist) && dist < hit.Distance) {
+                if (cache.IntersectRay(index, ray, dist) && dist < hit.Distance) {
                     if (dist > maxDist) return {}; // hit is too far
 
-                    if (seg.SideIsSolid(side, level)) { // todo: this isn't accurate due to door flags
+                    if (cache.IsSolid(index, level)) { // todo: this isn't accurate due to door flags
                         hit.Tag = { segId, side };
                         hit.Distance = dist;
                         hit.Normal = {}; // todo: normal
@@ -711,59 +734,63 @@ namespace Inferno {
         return false;
     }
 
-    // Intersects a capsule with the level
-    bool IntersectLevel(Level& level, const BoundingCapsule& capsule, SegID segId, const Object& object, LevelHit& hit) {
-        auto& seg = level.GetSegment(segId);
-        hit.Visited.insert(segId);
-
-        // Did we hit any objects in this segment?
-        for (int i = 0; i < level.Objects.size(); i++) {
-            auto& obj = level.Objects[i];
-            if (!Object::IsAlive(obj) || obj.Segment != segId) continue;
-            if (object.Parent == (ObjID)i || &obj == &object) continue; // don't hit yourself!
-            if (object.Parent == obj.Parent) continue; // Don't hit your siblings!
-
-            BoundingSphere sphere(obj.Position, obj.Radius);
-            if (auto info = capsule.Intersects(sphere)) {
-                hit.Update(info, &obj);
-            }
-        }
+    // Sweeps an object's sphere from its last position to its current one and finds the earliest hit.
+    // Segments are walked in the order the sphere reaches them, so the walk stops once the next segment
+    // is reached after the nearest hit. The hit distance is how far the object travels before the contact.
+    bool IntersectLevel(Level& level, const Object& object, LevelHit& hit, SegmentWalk& walk) {
+        auto& cache = level.Collision;
+        auto& start = object.LastPosition;
+        auto delta = object.Position - object.LastPosition;
+        auto length = delta.Length();
+        auto radius = object.Radius;
 
-        //if (hit) return hit; // Objects will always be inside of a segment, no need to check walls if we hit something
+        walk.BeginSweep(level, object.Segment);
 
-        for (auto& side : SideIDs) {
-            auto face = Face::FromSide(level, seg, side);
-            auto i = face.Side.GetRenderIndices();
+        SegID segId{};
+        float entry{};
+        while (walk.PopNearest(segId, entry)) {
+            if (entry * length >= hit.Distance) break; // everything left is reached after the nearest hit
 
-            Vector3 refPoint, normal;
-            float dist{};
-            if (capsule.Intersects(face[i[0]], face[i[1]], face[i[2]], face.Side.Normals[0], refPoint, normal, dist)) {
-                if (seg.SideIsSolid(side, level) && dist < hit.Distance) {
-                    hit.Normal = normal;
-                    hit.Point = refPoint;
-                    hit.Distance = dist;
-                    hit.Tag = { segId, side };
-                }
-                else {
-                    // scan touching seg
-                    auto conn = seg.GetConnection(side);
-                    if (conn > SegID::None && !hit.Visited.contains(conn))
-                        IntersectLevel(level, capsule, conn, object, hit);
-                }
+            auto& seg = level.GetSegment(segId);
+
+            // Did we hit any objects in this segment?
+            for (auto id : seg.Objects) {
+                auto& obj = level.GetObject(id);
+                if (!Object::IsAlive(obj) || obj.Segment != segId) continue;
+                if (object.Parent == id || &obj == &object) continue; // don't hit yourself!
+                if (object.Parent == obj.Parent) continue; // Don't hit your siblings!
+
+                SweepHit sweep;
+                if (SweepSphereSphere(start, delta, radius, obj.LastPosition, obj.Position - obj.LastPosition, obj.Radius, sweep))
+                    hit.Update({ .Distance = sweep.Time * length, .Point = sweep.Point, .Normal = sweep.Normal }, &obj);
             }
 
-            if (capsule.Intersects(face[i[3]], face[i[4]], face[i[5]], face.Side.Normals[1], refPoint, normal, dist)) {
-                if (seg.SideIsSolid(side, level) && dist < hit.Distance) {
-                    hit.Normal = normal;
-                    hit.Point = refPoint;
-                    hit.Distance = dist;
-                    hit.Tag = { segId, side };
+            for (auto& side : SideIDs) {
+                auto index = CollisionCache::SideIndex(segId, side);
+                SweepHit sweep;
+
+                for (int tri = index * 2; tri < index * 2 + 2; tri++) {
+                    // Both ends on the same side of the plane and further than the radius can't touch the triangle
+                    auto d0 = cache.PlaneDistance(tri, start), d1 = cache.PlaneDistance(tri, object.Position);
+                    if ((d0 > radius && d1 > radius) || (d0 < -radius && d1 < -radius))
+                        continue;
+
+                    SweepHit triHit;
+                    if (SweepSphereTriangle(start, delta, radius, cache.V0(tri), cache.V1(tri), cache.V2(tri), cache.Normal(tri), triHit) && triHit.Time < sweep.Time)
+                        sweep = triHit;
+                }
+
+                if (sweep.Time > 1) continue;
+
+                if (cache.IsSolid(index, level)) {
+                    if (sweep.Normal.Dot(delta) >= 0) continue; // moving out of the wall
+                    hit.Update({ .Distance = sweep.Time * length, .Point = sweep.Point, .Normal = sweep.Normal }, { segId, side });
                 }
                 else {
-                    // scan touching seg
+                    // the sphere reaches the connected segment at the time it touches the side
                     auto conn = seg.GetConnection(side);
-                    if (conn > SegID::None && !hit.Visited.contains(conn))
-                        IntersectLevel(level, capsule, conn, object, hit);
+                    if (conn > SegID::None)
+                        walk.Push(conn, sweep.Time);
                 }
             }
         }
@@ -813,20 +840,12 @@ namespace Inferno {
             isHit = true;
         }
         else {
-            // ray cast didn't hit anything, try the sphere test
-            // note that this is not a sweep and will miss points between the begin and end.
-            // Fortunately, most fast-moving objects are projectiles and have small radii.
-            BoundingSphere sphere(obj.Position, obj.Radius);
-            isHit = sphere.Intersects(t.Points[0], t.Points[1], t.Points[2]);
-
-            float planeDist;
-            ray.Intersects(plane, planeDist);
-            if (!isHit && planeDist <= expectedDistance) {
-                // Last, test if the object sphere collides with the intersection of the triangle's plane
-                sphere = BoundingSphere(obj.LastPosition + dir * planeDist, obj.Radius * 1.1f);
-                //BoundingSphere sphere(obj.Position(), obj.Radius);
-                isHit = sphere.Intersects(t.Points[0], t.Points[1], t.Points[2]);
-            }
+            // ray cast didn't hit anything, sweep the sphere so points between the begin and end aren't missed
+            SweepHit sweep;
+            isHit = SweepSphereTriangle(obj.LastPosition, delta, obj.Radius, t[0], t[1], t[2], plane.Normal(), sweep);
+
+            if (isHit)
+                obj.Position = obj.LastPosition + delta * sweep.Time; // back up to the contact instead of resolving from the far side
         }
 
         if (!isHit) return;
@@ -874,8 +893,13 @@ namespace Inferno {
 
 
     void UpdateGame(Level& level, double /*t*/, float dt) {
-        for (auto& obj : level.Objects) {
+        for (int id = 0; id < level.Objects.size(); id++) {
+            auto& obj = level.Objects[id];
+            if (!Object::IsAlive(obj)) continue;
+
             obj.Lifespan -= dt;
+            if (!Object::IsAlive(obj))
+                level.UnlinkObject((ObjID)id); // Despawned
         }
 
         UpdateDoors(level, dt);
@@ -913,6 +937,106 @@ namespace Inferno {
         }
     }
 
+    // Objects per batch in the parallel phases of a physics step
+    constexpr size_t PHYSICS_BATCH_SIZE = 32;
+    // Stepping fewer objects than this on other threads costs more than it saves
+    constexpr size_t PARALLEL_PHYSICS_MIN_OBJECTS = 128;
+
+    // Results of the parallel phase of a physics step for one object
+    struct PhysicsResult {
+        bool Moved = false; // Integrated and tested against the level
+        LevelHit Hit;
+    };
+
+    namespace {
+        List<PhysicsResult> PhysicsResults; // Indexed by object
+        List<SegmentWalk> CollisionWalks; // One per batch so batches can run at the same time
+        Ptr<WorkerPool> PhysicsWorkers; // Created on first use. Steps run too often to create threads for each phase.
+    }
+
+    // Calls fn(begin, end, walk) for batches of objects. Runs the batches on all threads when there are enough objects.
+    // Each batch only touches its own objects, so the result is the same either way.
+    void ForEachObjectBatch(size_t count, auto&& fn) {
+        auto batches = std::max((count + PHYSICS_BATCH_SIZE - 1) / PHYSICS_BATCH_SIZE, (size_t)1);
+        if (CollisionWalks.size() < batches)
+            CollisionWalks.resize(batches);
+
+        if (count < PARALLEL_PHYSICS_MIN_OBJECTS) {
+            for (size_t begin = 0; begin < count; begin += PHYSICS_BATCH_SIZE)
+                fn(begin, std::min(begin + PHYSICS_BATCH_SIZE, count), CollisionWalks[begin / PHYSICS_BATCH_SIZE]);
+        }
+        else {
+            if (!PhysicsWorkers) PhysicsWorkers = MakePtr<WorkerPool>();
+
+            PhysicsWorkers->ParallelFor(count, PHYSICS_BATCH_SIZE, [&](size_t begin, size_t end) {
+                fn(begin, end, CollisionWalks[begin / PHYSICS_BATCH_SIZE]);
+            });
+        }
+    }
+
+    // Applies the side effects of a hit: doors, sounds, particles and forces on the object that was hit
+    void CommitHit(Level& level, Object& obj, ObjID id, const LevelHit& hit) {
+        Debug::ClosestPoints.push_back(hit.Point);
+        Render::Debug::DrawLine(hit.Point, hit.Point + hit.Normal, { 1, 0, 0 });
+
+        if (obj.Type == ObjectType::Weapon) {
+            obj.Lifespan = -1;
+            level.UnlinkObject(id);
+        }
+
+        if (auto wall = level.TryGetWall(hit.Tag)) {
+            if (wall->Type == WallType::Door) {
+                if (obj.Type == ObjectType::Weapon && wall->HasFlag(WallFlag::DoorLocked)) {
+                    // Can't open door
+                    Sound::Sound3D sound(hit.Point, hit.Tag.Segment);
+                    sound.Resource = Resources::GetSoundResource(Sound::SOUND_WEAPON_HIT_DOOR);
+                    sound.Source = obj.Parent;
+                    Sound::Play(sound);
+                }
+                else if (wall->State != WallState::DoorOpening) {
+                    OpenDoor(level, hit.Tag);
+                }
+            }
+        }
+        else {
+            if (obj.Type == ObjectType::Weapon) {
+                auto& weapon = Resources::GameData.Weapons[obj.ID];
+                ApplyHit(hit, obj);
+
+                if (hit.HitObj && hit.HitObj->Type == ObjectType::Robot) {
+                    Sound::Sound3D sound(hit.Point, hit.Tag.Segment);
+                    sound.Resource = Resources::GetSoundResource(weapon.RobotHitSound);
+                    sound.Source = obj.Parent;
+                    Sound::Play(sound);
+
+                    auto& ri = Resources::GetRobotInfo(hit.HitObj->ID);
+                    if (ri.ExplosionClip1 > VClipID::None) {
+                        Render::Particle p{};
+                        p.Position = hit.Point;
+                        p.Radius = weapon.ImpactSize; // (robot->size / 2 * 3)
+                        p.Clip = ri.ExplosionClip1;
+                        Render::AddParticle(p);
+                    }
+                }
+                else {
+                    Sound::Sound3D sound(hit.Point, hit.Tag.Segment);
+                    sound.Resource = Resources::GetSoundResource(weapon.WallHitSound);
+                    sound.Source = obj.Parent;
+                    Sound::Play(sound);
+
+                    Render::Particle p{};
+                    p.Position = hit.Point;
+                    p.Radius = weapon.ImpactSize;
+                    p.Clip = weapon.WallHitVClip;
+                    Render::AddParticle(p);
+                }
+            }
+        }
+    }
+
+    // A step has two phases. The first integrates every object and then tests it against the level on all threads.
+    // It only reads the level and writes to each object and its result. The second applies the hits one object
+    // at a time in object order, so doors, sounds, particles and forces happen in the same order on any thread count.
     void UpdatePhysics(Level& level, double t, float dt) {
         Debug::Steps = 0;
         Debug::ClosestPoints.clear();
@@ -921,106 +1045,68 @@ namespace Inferno {
 
         UpdateGame(level, t, dt);
 
-        for (int id = 0; id < level.Objects.size(); id++) {
-            auto& obj = level.Objects[id];
-            if (!Object::IsAlive(obj)) continue;
+        // The collision queries only read the cache, so bring it up to date before they run in parallel
+        level.Collision.Update(level);
 
-            obj.LastPosition = obj.Position;
-            obj.LastRotation = obj.Rotation;
+        auto count = level.Objects.size();
+        PhysicsResults.resize(count);
 
-            if (obj.Movement.Type == MovementType::Physics) {
-                FixedPhysics(obj, dt);
+        // Integrate every object before testing any of them, so no test reads an object that is moving
+        ForEachObjectBatch(count, [&](size_t begin, size_t end, SegmentWalk&) {
+            for (size_t id = begin; id < end; id++) {
+                auto& obj = level.Objects[id];
+                auto& result = PhysicsResults[id];
+                result = { .Hit = { .Source = &obj } };
+                if (!Object::IsAlive(obj)) continue;
 
-                //if (obj.Movement.Physics.HasFlag(PhysicsFlag::Wiggle))
-                //    WiggleObject(obj, t, dt, Resources::GameData.PlayerShip.Wiggle); // rather hacky, assumes the ship is the only thing that wiggles
+                obj.LastPosition = obj.Position;
+                obj.LastRotation = obj.Rotation;
 
-                obj.Movement.Physics.InputVelocity = obj.Movement.Physics.Velocity;
-                obj.Position += obj.Movement.Physics.Velocity * dt;
+                if (obj.Movement.Type == MovementType::Physics) {
+                    FixedPhysics(obj, dt);
 
+                    //if (obj.Movement.Physics.HasFlag(PhysicsFlag::Wiggle))
+                    //    WiggleObject(obj, t, dt, Resources::GameData.PlayerShip.Wiggle); // rather hacky, assumes the ship is the only thing that wiggles
+
+                    obj.Movement.Physics.InputVelocity = obj.Movement.Physics.Velocity;
+                    obj.Position += obj.Movement.Physics.Velocity * dt;
+                    result.Moved = true;
+                }
+            }
+        });
+
+        ForEachObjectBatch(count, [&](size_t begin, size_t end, SegmentWalk& walk) {
+            for (size_t id = begin; id < end; id++) {
+                auto& result = PhysicsResults[id];
+                if (!result.Moved) continue;
+
+                auto& obj = level.Objects[id];
                 auto delta = obj.Position - obj.LastPosition;
                 auto maxDistance = delta.Length();
-                LevelHit hit{ .Source = &obj };
 
                 if (maxDistance < 0.001f) {
                     // no travel, but need to check for being inside of wall (maybe this isn't necessary)
                     BoundingSphere sphere(obj.Position, obj.Radius);
-
-                    if (IntersectLevel(level, sphere, obj.Segment, (ObjID)id, hit)) {
-                        Debug::ClosestPoints.push_back(hit.Point);
-                        Render::Debug::DrawLine(hit.Point, hit.Point + hit.Normal, { 1, 0, 0 });
-                    }
+                    IntersectLevel(level, sphere, obj.Segment, (ObjID)id, result.Hit, walk);
                 }
                 else {
-                    Vector3 dir;
-                    delta.Normalize(dir);
-                    //auto expectedTravel = (obj.Position() - obj.PrevPosition()).Length();
-
-                    Ray ray(obj.LastPosition, dir);
-
-                    BoundingCapsule capsule{ .A = obj.LastPosition, .B = obj.Position, .Radius = obj.Radius };
-
-                    if (IntersectLevel(level, capsule, obj.Segment, obj, hit)) {
-
-                        //Render::Debug::DrawPoint(hit.Point, { 1, 1, 0 });
-                        Debug::ClosestPoints.push_back(hit.Point);
-                        Render::Debug::DrawLine(hit.Point, hit.Point + hit.Normal, { 1, 0, 0 });
-                    }
+                    IntersectLevel(level, obj, result.Hit, walk);
                 }
+            }
+        });
 
-                if (hit) {
-                    if (obj.Type == ObjectType::Weapon) {
-                        obj.Lifespan = -1;
-                    }
+        // Commit the hits in object order
+        for (int id = 0; id < level.Objects.size(); id++) {
+            auto& obj = level.Objects[id];
+            if (!Object::IsAlive(obj)) continue;
 
-                    if (auto wall = level.TryGetWall(hit.Tag)) {
-                        if (wall->Type == WallType::Door) {
-                            if (obj.Type == ObjectType::Weapon && wall->HasFlag(WallFlag::DoorLocked)) {
-                                // Can't open door
-                                Sound::Sound3D sound(hit.Point, hit.Tag.Segment);
-                                sound.Resource = Resources::GetSoundResource(Sound::SOUND_WEAPON_HIT_DOOR);
-                                sound.Source = obj.Parent;
-                                Sound::Play(sound);
-                            }
-                            else if (wall->State != WallState::DoorOpening) {
-                                OpenDoor(level, hit.Tag);
-                            }
-                        }
-                    }
-                    else {
-                        if (obj.Type == ObjectType::Weapon) {
-                            auto& weapon = Resources::GameData.Weapons[obj.ID];
-                            ApplyHit(hit, obj);
-
-                            if (hit.HitObj && hit.HitObj->Type == ObjectType::Robot) {
-                                Sound::Sound3D sound(hit.Point, hit.Tag.Segment);
-                                sound.Resource = Resources::GetSoundResource(weapon.RobotHitSound);
-                                sound.Source = obj.Parent;
-                                Sound::Play(sound);
-
-                                auto& ri = Resources::GetRobotInfo(hit.HitObj->ID);
-                                if (ri.ExplosionClip1 > VClipID::None) {
-                                    Render::Particle p{};
-                                    p.Position = hit.Point;
-                                    p.Radius = weapon.ImpactSize; // (robot->size / 2 * 3)
-                                    p.Clip = ri.ExplosionClip1;
-                                    Render::AddParticle(p);
-                                }
-                            }
-                            else {
-                                Sound::Sound3D sound(hit.Point, hit.Tag.Segment);
-                                sound.Resource = Resources::GetSoundResource(weapon.WallHitSound);
-                                sound.Source = obj.Parent;
-                                Sound::Play(sound);
-
-                                Render::Particle p{};
-                                p.Position = hit.Point;
-                                p.Radius = weapon.ImpactSize;
-                                p.Clip = weapon.WallHitVClip;
-                                Render::AddParticle(p);
-                            }
-                        }
-                    }
-                }
+            if (auto& result = PhysicsResults[id]; result.Moved) {
+                // The hits were found before any were applied, so the object that was hit may have died earlier in this loop
+                if (result.Hit.HitObj && !Object::IsAlive(*result.Hit.HitObj))
+                    result.Hit = { .Source = &obj };
+
+                if (result.Hit)
+                    CommitHit(level, obj, (ObjID)id, result.Hit);
 
                 //CollideTriangles(level, obj, dt, 0);
                 //CollideTriangles(level, obj, dt, 1); // Doing two passes makes the result more stable
@@ -1028,7 +1114,12 @@ namespace Inferno {
 
                 //auto frameVec = obj.Position() - obj.PrevTransform.Translation();
                 //obj.Movement.Physics.Velocity = frameVec / dt;
-                Editor::UpdateObjectSegment(level, obj);
+                Editor::UpdateObjectSegment(level, (ObjID)id);
+            }
+
+            if (obj.Type == ObjectType::Player) {
+                Debug::ShipThrust = obj.Movement.Physics.AngularThrust;
+                Debug::ShipAcceleration = Vector3::Zero;
             }
 
             Render::Debug::DrawLine(obj.LastPosition, obj.Position, { 0, 1.0f, 0.2f });
@@ -25,7 +25,6 @@ namespace Inferno {
         Object* HitObj = nullptr;
         float Distance = FLT_MAX;
         Vector3 Point, Normal;
-        Set<SegID> Visited; // visited segments
 
         void Update(const HitInfo& hit, Object* obj) {
             if (!obj || hit.Distance > Distance) return;
@@ -33,6 +32,7 @@ namespace Inferno {
             Point = hit.Point;
             Normal = hit.Normal;
             HitObj = obj;
+            Tag = {}; // nearer than any wall
         }
 
         void Update(const HitInfo& hit, struct Tag tag) {
@@ -41,6 +41,7 @@ namespace Inferno {
             Point = hit.Point;
             Normal = hit.Normal;
             Tag = tag;
+            HitObj = nullptr; // nearer than any object
         }
 
         operator bool() { return Distance != FLT_MAX; }
@@ -3,6 +3,9 @@
 #include "FileSystem.h"
 #include "Sound.h"
 #include "Pig.h"
+#include "TextureCache.h"
+#include "BitmapStore.h"
+#include "Settings.h"
 #include <fstream>
 #include <mutex>
 #include "Game.h"
@@ -21,12 +24,14 @@ namespace Inferno::Resources {
         Palette LevelPalette;
         PigFile Pig;
         List<PigBitmap> Textures;
+        Ptr<BitmapStore> PagedTextures; // Replaces Textures when demand paging is enabled
 
         std::mutex PigMutex;
         List<PaletteInfo> AvailablePalettes;
+        bool TexturesFromCache = false; // Base texture average colors were loaded from the cache
     }
 
-    int GetTextureCount() { return (int)Textures.size(); }
+    int GetTextureCount() { return PagedTextures ? (int)PagedTextures->Count() : (int)Textures.size(); }
     const Palette& GetPalette() { return LevelPalette; }
 
     void LoadRobotNames(const filesystem::path& path) {
@@ -246,12 +251,33 @@ namespace Inferno::Resources {
         return src.substr(0, offset) + ext;
     }
 
-    void UpdateAverageTextureColor() {
+    void UpdateAverageTextureColor(const Level& level) {
         SPDLOG_INFO("Update average texture color");
+        bool paged = PagedTextures && PagedTextures->Count() > 0;
+        Set<TexID> levelTextures;
+        if (paged) levelTextures = Render::GetLevelSegmentTextures(level);
 
         for (auto& entry : Pig.Entries) {
-            auto& bmp = GetBitmap(entry.ID);
-            entry.AverageColor = GetAverageColor(bmp.Data);
+            if (auto custom = CustomResources.Get(entry.ID)) {
+                entry.AverageColor = GetAverageColor(custom->Data);
+                continue;
+            }
+
+            // Cached textures already have their average
+            if (TexturesFromCache) continue;
+
+            if (paged) {
+                // Only decode the textures on the level's sides, which are needed to render it anyway.
+                // The store records the average of any other texture when it is first used.
+                if (levelTextures.contains(entry.ID))
+                    PagedTextures->Get(entry.ID);
+
+                if (auto color = PagedTextures->GetAverageColor(entry.ID))
+                    entry.AverageColor = *color;
+            }
+            else if (Seq::inRange(Textures, (int)entry.ID)) {
+                entry.AverageColor = GetAverageColor(Textures[(int)entry.ID].Data);
+            }
         }
         //for (auto& tid : GameData.LevelTexIdx) {
         //    auto id = LookupLevelTexID(tid);
@@ -311,13 +337,51 @@ namespace Inferno::Resources {
         throw Exception(msg);
     }
 
+    // Loads decoded textures from the cache, or decodes them and updates the cache
+    List<PigBitmap> ReadCachedBitmaps(PigFile& pig, const Palette& palette, span<const ubyte> paletteData) {
+        TexturesFromCache = false;
+        auto& settings = Settings::Inferno;
+        if (settings.DemandPagedTextures)
+            return {}; // Decoded on first use by the paged store
+
+        if (!settings.EnableTextureCache)
+            return ReadAllBitmaps(pig, palette);
+
+        try {
+            TextureCache cache(settings.TextureCachePath, (uintmax_t)std::max(settings.TextureCacheSize, 0) * 1024 * 1024);
+            TextureCacheKey key{ HashFile(pig.Path), HashBytes(paletteData) };
+
+            if (auto textures = cache.Read(key, pig.Entries)) {
+                SPDLOG_INFO("Loaded textures from cache {}", key.FileName());
+                TexturesFromCache = true;
+                return std::move(*textures);
+            }
+
+            auto textures = ReadAllBitmaps(pig, palette);
+            cache.Write(key, textures);
+            return textures;
+        }
+        catch (const std::exception& e) {
+            SPDLOG_WARN("Texture cache error: {}", e.what());
+            return ReadAllBitmaps(pig, palette);
+        }
+    }
+
+    Ptr<BitmapStore> CreatePagedTextures(const PigFile& pig, const Palette& palette) {
+        auto& settings = Settings::Inferno;
+        if (!settings.DemandPagedTextures) return {};
+
+        auto budget = (size_t)std::max(settings.TextureMemoryBudget, 0) * 1024 * 1024;
+        return MakePtr<BitmapStore>(pig, palette, budget, settings.CompactTextures);
+    }
+
     void LoadDescent2Resources(Level& level) {
         std::scoped_lock lock(PigMutex);
         SPDLOG_INFO("Loading Descent 2 level: '{}'\r\n Version: {} Segments: {} Vertices: {}", level.Name, level.Version, level.Segments.size(), level.Vertices.size());
         auto hamData = ReadGameResource("descent2.ham");
         StreamReader reader(hamData);
         auto ham = ReadHam(reader);
-        auto hog = HogFile::Read(FileSystem::FindFile(L"descent2.hog"));
+        auto hog = HogFile::Read(FileSystem::FindFile(L"descent2.hog"), true);
 
         // Find the 256 for the palette first. In most cases it is located inside of the hog.
         // But for custom palettes it is on the filesystem
@@ -339,7 +403,8 @@ namespace Inferno::Resources {
 
         auto pig = ReadPigFile(pigPath);
         auto palette = ReadPalette(paletteData);
-        auto textures = ReadAllBitmaps(pig, palette);
+        auto textures = ReadCachedBitmaps(pig, palette, paletteData);
+        auto pagedTextures = CreatePagedTextures(pig, palette);
 
         if (level.IsVertigo()) {
             auto vHog = HogFile::Read(FileSystem::FindFile(L"d2x.hog"));
@@ -364,6 +429,7 @@ namespace Inferno::Resources {
         Hog = std::move(hog);
         GameData = std::move(ham);
         Textures = std::move(textures);
+        PagedTextures = std::move(pagedTextures);
 
         // Read hxm
         auto hxm = ReplaceExtension(level.FileName, ".hxm");
@@ -454,7 +520,7 @@ namespace Inferno::Resources {
     void LoadDescent1Resources(Level& level) {
         std::scoped_lock lock(PigMutex);
         SPDLOG_INFO("Loading Descent 1 level: '{}'\r\n Version: {} Segments: {} Vertices: {}", level.Name, level.Version, level.Segments.size(), level.Vertices.size());
-        auto hog = HogFile::Read(FileSystem::FindFile(L"descent.hog"));
+        auto hog = HogFile::Read(FileSystem::FindFile(L"descent.hog"), true);
         auto paletteData = hog.ReadEntry("palette.256");
         auto palette = ReadPalette(paletteData);
 
@@ -464,7 +530,8 @@ namespace Inferno::Resources {
         pig.Path = path;
         sounds.Path = path;
         //ReadBitmap(pig, palette, TexID(61)); // cockpit
-        auto textures = ReadAllBitmaps(pig, palette);
+        auto textures = ReadCachedBitmaps(pig, palette, paletteData);
+        auto pagedTextures = CreatePagedTextures(pig, palette);
 
         filesystem::path folder = level.Path;
         folder.remove_filename();
@@ -479,6 +546,7 @@ namespace Inferno::Resources {
 
         // Everything loaded okay, set the internal data
         Textures = std::move(textures);
+        PagedTextures = std::move(pagedTextures);
         LevelPalette = std::move(palette);
         Pig = std::move(pig);
         Hog = std::move(hog);
@@ -493,6 +561,8 @@ namespace Inferno::Resources {
         GameData = {};
         CustomResources.Clear();
         Textures.clear();
+        PagedTextures.reset();
+        TexturesFromCache = false;
     }
 
     // Some old levels didn't properly set the render model ids.
@@ -541,7 +611,7 @@ namespace Inferno::Resources {
                 throw Exception("Unsupported level version");
             }
 
-            UpdateAverageTextureColor();
+            UpdateAverageTextureColor(level);
 
             FixObjectModelIds(level);
             ResetObjectSizes(level);
@@ -553,13 +623,18 @@ namespace Inferno::Resources {
 
     const PigBitmap DEFAULT_BITMAP = { PigEntry{ "default", 64, 64 } };
 
-    const PigBitmap& GetBitmap(TexID id) {
+    Ref<const PigBitmap> GetBitmapRef(TexID id) {
+        // Custom and resident bitmaps live until the next level load, so the reference doesn't own them
+        if (auto bmp = CustomResources.Get(id)) return { Ref<const PigBitmap>(), bmp };
+
+        if (PagedTextures && PagedTextures->Count() > 0)
+            return PagedTextures->Get(id);
+
         if (Textures.empty())
-            return DEFAULT_BITMAP;
+            return { Ref<const PigBitmap>(), &DEFAULT_BITMAP };
 
-        if (auto bmp = CustomResources.Get(id)) return *bmp;
         if (!Seq::inRange(Textures, (int)id)) id = (TexID)0;
-        return Textures[(int)id];
+        return { Ref<const PigBitmap>(), &Textures[(int)id] };
     }
 
     List<ubyte> ReadFile(string file) {
@@ -590,7 +665,9 @@ namespace Inferno::Resources {
             throw Exception("File not found");
         }
 
-        auto level = Level::Deserialize(data);
+        LevelReadTimes times;
+        auto level = Level::Deserialize(data, &times);
+        SPDLOG_INFO("Read {} in {}", name, times.Format());
         level.FileName = name;
         return level;
     }
@@ -602,28 +679,52 @@ namespace Inferno::Resources {
     bool FoundMercenary() { return FileSystem::TryFindFile("merc.hog").has_value(); } // todo: steam release of merc uses a different hog name
 
     // Opens a file stream from the data paths or the loaded hogs
-    Option<StreamReader> OpenFile(const string& name) {
-        // Check file system first, then hogs
+    // Reads a Descent 3 file. Checks the file system first, then hogs.
+    Option<List<ubyte>> ReadDescent3File(const string& name) {
         if (auto path = FileSystem::TryFindFile(name))
-            return StreamReader(*path);
-        else if (auto data = Descent3Hog.ReadEntry(name))
+            return File::ReadAllBytes(*path);
+
+        return Descent3Hog.ReadEntry(name);
+    }
+
+    Option<StreamReader> OpenFile(const string& name) {
+        // Read into memory for the buffered reader
+        if (auto data = ReadDescent3File(name))
             return StreamReader(std::move(*data), name);
 
         return {};
     }
 
     void LoadVClips() {
+        List<const Outrage::TextureInfo*> textures;
+        List<List<ubyte>> files;
+
         for (auto& tex : GameTable.Textures) {
             if (!tex.Animated()) continue;
 
-            if (auto r = OpenFile(tex.FileName)) {
-                auto vc = Outrage::VClip::Read(*r);
-                if (vc.Frames.size() > 0)
-                    vc.FrameTime = tex.Speed / vc.Frames.size();
-                vc.FileName = tex.FileName;
-                VClips.push_back(std::move(vc));
+            if (auto data = ReadDescent3File(tex.FileName)) {
+                textures.push_back(&tex);
+                files.push_back(std::move(*data));
             }
         }
+
+        // Decode every clip in parallel
+        auto vclips = Outrage::ReadVClips(files);
+
+        for (size_t i = 0; i < vclips.size(); i++) {
+            auto& tex = *textures[i];
+            auto& vc = vclips[i];
+
+            if (!vc) {
+                SPDLOG_WARN("Error reading vclip {}", tex.FileName);
+                continue;
+            }
+
+            if (vc->Frames.size() > 0)
+                vc->FrameTime = tex.Speed / vc->Frames.size();
+            vc->FileName = tex.FileName;
+            VClips.push_back(std::move(*vc));
+        }
     }
 
     void MountDescent3() {
@@ -658,6 +759,24 @@ namespace Inferno::Resources {
         return {};
     }
 
+    List<Option<Outrage::Bitmap>> ReadOutrageBitmaps(span<const string> names) {
+        List<List<ubyte>> files(names.size());
+
+        for (size_t i = 0; i < names.size(); i++) {
+            if (auto data = ReadDescent3File(names[i]))
+                files[i] = std::move(*data);
+        }
+
+        auto bitmaps = Outrage::ReadBitmaps(files);
+
+        for (size_t i = 0; i < bitmaps.size(); i++) {
+            if (!bitmaps[i] && !files[i].empty())
+                SPDLOG_WARN("Error reading texture {}", names[i]);
+        }
+
+        return bitmaps;
+    }
+
     Option<Outrage::Bitmap> ReadOutrageVClip(const string& name) {
         try {
             if (auto r = OpenFile(name)) {
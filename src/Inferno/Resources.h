@@ -58,8 +58,13 @@ namespace Inferno::Resources {
     // Loads the corresponding resources for a level
     void LoadLevel(Level&);
 
-    // Returns bitmap data for a TexID
-    const PigBitmap& GetBitmap(TexID);
+    // Returns bitmap data for a TexID that stays valid while the reference is held.
+    // Demand paged bitmaps can be released as soon as the reference is dropped.
+    Ref<const PigBitmap> GetBitmapRef(TexID);
+
+    // Updates the average colors of textures used for light colors.
+    // When textures are demand paged only the level's side textures are decoded, others are updated once they are used.
+    void UpdateAverageTextureColor(const Level&);
 
     // Returns a modifiable bitmap
     PigBitmap& AccessBitmap(TexID);
@@ -87,6 +92,8 @@ namespace Inferno::Resources {
     Option<StreamReader> OpenFile(const string& name);
 
     Option<Outrage::Bitmap> ReadOutrageBitmap(const string& name);
+    // Reads several bitmaps and decodes them in parallel. Missing or invalid files are returned empty.
+    List<Option<Outrage::Bitmap>> ReadOutrageBitmaps(span<const string> names);
     Option<Outrage::Bitmap> ReadOutrageVClip(const string& name);
     Option<Outrage::Model> ReadOutrageModel(const string& name);
 
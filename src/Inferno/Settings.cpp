@@ -115,6 +115,7 @@ namespace Inferno {
         node["Radius"] << s.Radius;
         node["Reflectance"] << s.Reflectance;
         node["Multithread"] << s.Multithread;
+        node["Preview"] << s.Preview;
     }
 
     LightSettings LoadLightSettings(ryml::NodeRef node) {
@@ -133,6 +134,7 @@ namespace Inferno {
         ReadValue(node["Radius"], settings.Radius);
         ReadValue(node["Reflectance"], settings.Reflectance);
         ReadValue(node["Multithread"], settings.Multithread);
+        ReadValue(node["Preview"], settings.Preview);
         return settings;
     }
 
@@ -341,6 +343,12 @@ namespace Inferno {
             doc["Descent1Path"] << Settings::Inferno.Descent1Path.string();
             doc["Descent2Path"] << Settings::Inferno.Descent2Path.string();
             WriteSequence(doc["DataPaths"], Settings::Inferno.DataPaths);
+            doc["EnableTextureCache"] << Settings::Inferno.EnableTextureCache;
+            doc["TextureCachePath"] << Settings::Inferno.TextureCachePath.string();
+            doc["TextureCacheSize"] << Settings::Inferno.TextureCacheSize;
+            doc["DemandPagedTextures"] << Settings::Inferno.DemandPagedTextures;
+            doc["TextureMemoryBudget"] << Settings::Inferno.TextureMemoryBudget;
+            doc["CompactTextures"] << Settings::Inferno.CompactTextures;
             SaveEditorSettings(doc["Editor"], Settings::Editor);
             SaveGraphicsSettings(doc["Render"], Settings::Graphics);
             SaveBindings(doc["Bindings"]);
@@ -375,6 +383,13 @@ namespace Inferno {
                     }
                 }
 
+                ReadValue(root["EnableTextureCache"], Settings::Inferno.EnableTextureCache);
+                ReadValue(root["TextureCachePath"], Settings::Inferno.TextureCachePath);
+                ReadValue(root["TextureCacheSize"], Settings::Inferno.TextureCacheSize);
+                ReadValue(root["DemandPagedTextures"], Settings::Inferno.DemandPagedTextures);
+                ReadValue(root["TextureMemoryBudget"], Settings::Inferno.TextureMemoryBudget);
+                ReadValue(root["CompactTextures"], Settings::Inferno.CompactTextures);
+
                 Settings::Editor = LoadEditorSettings(root["Editor"], Settings::Inferno);
                 Settings::Graphics = LoadGraphicsSettings(root["Render"]);
                 auto bindings = root["Bindings"];
@@ -41,9 +41,12 @@ namespace Inferno {
         bool SkipFirstPass = false;
         float LightPlaneTolerance = -0.45f;
         bool Multithread = true;
+        bool Preview = false; // Limits bounces and skips dim bounce sources for faster, rougher bakes
 
         // Retired settings
         bool CheckCoplanar = true;
+
+        bool operator==(const LightSettings&) const = default;
     };
 
 
@@ -145,6 +148,14 @@ namespace Inferno {
         List<filesystem::path> DataPaths;
         filesystem::path Descent1Path, Descent2Path;
 
+        bool EnableTextureCache = true; // Stores decoded textures on disk to speed up loading
+        filesystem::path TextureCachePath = "cache";
+        int TextureCacheSize = 512; // Megabytes
+
+        bool DemandPagedTextures = false; // Decodes textures on first use instead of keeping all of them resident
+        int TextureMemoryBudget = 256; // Megabytes of decoded textures to keep when demand paging
+        bool CompactTextures = false; // Keeps only 8-bit indices resident when demand paging
+
         bool ScreenshotMode = false; // game setting?
     };
 